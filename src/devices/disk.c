@@ -7,6 +7,7 @@
 #include "threads/io.h"
 #include "threads/interrupt.h"
 #include "threads/synch.h"
+#include "threads/workqueue.h"
 
 /* The code in this file is an interface to an ATA (IDE)
    controller.  It attempts to comply to [ATA-3]. */
@@ -74,6 +75,7 @@ struct channel
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    struct work unexpected_work;        /* Reports unexpected interrupt. */
 
     struct disk devices[2];     /* The devices on this channel. */
   };
@@ -97,6 +99,7 @@ static void select_device (const struct disk *);
 static void select_device_wait (const struct disk *);
 
 static void interrupt_handler (struct intr_frame *);
+static work_func report_unexpected;
 
 /* Initialize the disk subsystem and detect disks. */
 void
@@ -127,6 +130,7 @@ disk_init (void)
       lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      work_init (&c->unexpected_work, report_unexpected, c);
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -546,7 +550,8 @@ select_device_wait (const struct disk *d)
   wait_until_idle (d);
 }
 
-/* ATA interrupt handler. */
+/* ATA interrupt handler.  Printing is slow, so an unexpected
+   interrupt is reported later, by report_unexpected(). */
 static void
 interrupt_handler (struct intr_frame *f) 
 {
@@ -561,11 +566,21 @@ interrupt_handler (struct intr_frame *f)
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
-          printf ("%s: unexpected interrupt\n", c->name);
+          work_queue (&c->unexpected_work);
         return;
       }
 
   NOT_REACHED ();
 }
 
+/* Work function that reports an unexpected interrupt on
+   CHANNEL_. */
+static void
+report_unexpected (void *channel_) 
+{
+  struct channel *c = channel_;
+
+  printf ("%s: unexpected interrupt\n", c->name);
+}
+
 
@@ -31,6 +31,15 @@ intq_full (const struct intq *q)
   return next (q->head) == q->tail;
 }
 
+/* Returns the number of bytes that can be added to Q before it
+   is full. */
+int
+intq_space (const struct intq *q) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return (q->tail - q->head - 1 + INTQ_BUFSIZE) % INTQ_BUFSIZE;
+}
+
 /* Removes a byte from Q and returns it.
    Q must not be empty if called from an interrupt handler.
    Otherwise, if Q is empty, first sleeps until a byte is
@@ -4,8 +4,10 @@
 #include <stdio.h>
 #include <string.h>
 #include "devices/input.h"
+#include "devices/intq.h"
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/workqueue.h"
 
 /* Keyboard data register port. */
 #define DATA_REG 0x60
@@ -23,12 +25,21 @@ static bool caps_lock;
 /* Number of keys pressed. */
 static int64_t key_cnt;
 
+/* Scancode bytes read by the interrupt handler and not yet
+   interpreted, and the work item that interprets them. */
+static struct intq scancodes;
+static struct work keyboard_work;
+
 static intr_handler_func keyboard_interrupt;
+static work_func interpret_scancodes;
+static void interpret_scancode (unsigned code);
 
 /* Initializes the keyboard. */
 void
 kbd_init (void) 
 {
+  intq_init (&scancodes);
+  work_init (&keyboard_work, interpret_scancodes, NULL);
   intr_register_ext (0x21, keyboard_interrupt, "8042 Keyboard");
 }
 
@@ -90,28 +101,82 @@ static const struct keymap shifted_keymap[] =
 
 static bool map_key (const struct keymap[], unsigned scancode, uint8_t *);
 
+/* Keyboard interrupt handler.  Reads the scancode, including
+   the second byte if there is a prefix code, and leaves the rest
+   to interpret_scancodes().  If the work queue has fallen so far
+   behind that the whole scancode does not fit, it is dropped;
+   queuing only its prefix would attach the prefix to the next
+   scancode instead. */
 static void
 keyboard_interrupt (struct intr_frame *args UNUSED) 
+{
+  uint8_t bytes[2];
+  int cnt = 0;
+  int i;
+
+  bytes[cnt++] = inb (DATA_REG);
+  if (bytes[0] == 0xe0) 
+    bytes[cnt++] = inb (DATA_REG);
+
+  if (intq_space (&scancodes) >= cnt)
+    for (i = 0; i < cnt; i++)
+      intq_putc (&scancodes, bytes[i]);
+  work_queue (&keyboard_work);
+}
+
+/* Work function that interprets the scancodes queued by
+   keyboard_interrupt().  Takes all the queued bytes at once, with
+   interrupts off only briefly, and interprets them with
+   interrupts on. */
+static void
+interpret_scancodes (void *aux UNUSED) 
+{
+  /* True if the last byte was a prefix code. */
+  static bool prefix;
+
+  for (;;) 
+    {
+      uint8_t bytes[INTQ_BUFSIZE];
+      enum intr_level old_level;
+      size_t cnt, i;
+
+      old_level = intr_disable ();
+      for (cnt = 0; !intq_empty (&scancodes); cnt++)
+        bytes[cnt] = intq_getc (&scancodes);
+      intr_set_level (old_level);
+      if (cnt == 0)
+        break;
+
+      for (i = 0; i < cnt; i++)
+        if (bytes[i] == 0xe0)
+          prefix = true;
+        else 
+          {
+            interpret_scancode (prefix ? 0xe000 | bytes[i] : bytes[i]);
+            prefix = false;
+          }
+    }
+}
+
+/* Updates the state of the shift keys, or adds a character to
+   the input buffer, for scancode CODE.  Called only from the
+   worker thread, which owns the shift state. */
+static void
+interpret_scancode (unsigned code) 
 {
   /* Status of shift keys. */
   bool shift = left_shift || right_shift;
   bool alt = left_alt || right_alt;
   bool ctrl = left_ctrl || right_ctrl;
 
-  /* Keyboard scancode. */
-  unsigned code;
-
   /* False if key pressed, true if key released. */
   bool release;
 
+  enum intr_level old_level;
+
   /* Character that corresponds to `code'. */
   uint8_t c;
 
-  /* Read scancode, including second byte if prefix code. */
-  code = inb (DATA_REG);
-  if (code == 0xe0)
-    code = (code << 8) | inb (DATA_REG);
-
   /* Bit 0x80 distinguishes key press from key release
      (even if there's a prefix). */
   release = (code & 0x80) != 0;
@@ -148,11 +213,13 @@ keyboard_interrupt (struct intr_frame *args UNUSED)
             c += 0x80;
 
           /* Append to keyboard buffer. */
+          old_level = intr_disable ();
           if (!input_full ())
             {
               key_cnt++;
               input_putc (c);
             }
+          intr_set_level (old_level);
         }
     }
   else
@@ -7,6 +7,7 @@
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 
 /* Register definitions for the 16550A UART used in PCs.
    The 16550A has a lot more going on than shown here, but this
@@ -51,13 +52,22 @@
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
 
+/* Maximum number of bytes that transfer() moves in each
+   direction with interrupts off. */
+#define TRANSFER_CHUNK 16
+
 /* Data to be transmitted. */
 static struct intq txq;
 
+/* Moves data between the UART and the queues on behalf of
+   serial_interrupt(). */
+static struct work serial_work;
+
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
 static intr_handler_func serial_interrupt;
+static work_func transfer;
 
 /* Initializes the serial port device for polling mode.
    Polling mode busy-waits for the serial port to become free
@@ -87,6 +97,7 @@ serial_init_queue (void)
     init_poll ();
   ASSERT (mode == POLL);
 
+  work_init (&serial_work, transfer, NULL);
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
   mode = QUEUE;
   old_level = intr_disable ();
@@ -112,13 +123,16 @@ serial_putc (uint8_t byte)
     {
       /* Otherwise, queue a byte and update the interrupt enable
          register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      if ((old_level == INTR_OFF || workqueue_in_worker ())
+          && intq_full (&txq)) 
         {
           /* Interrupts are off and the transmit queue is full.
              If we wanted to wait for the queue to empty,
              we'd have to reenable interrupts.
              That's impolite, so we'll send a character via
-             polling instead. */
+             polling instead.  Likewise in a work function,
+             because the queue is emptied by serial_work, which
+             cannot run until the current work is done. */
           putc_poll (intq_getc (&txq)); 
         }
 
@@ -205,7 +219,9 @@ putc_poll (uint8_t byte)
   outb (THR_REG, byte);
 }
 
-/* Serial interrupt handler. */
+/* Serial interrupt handler.  Masks the UART's interrupts and
+   leaves the transfer to transfer(), which unmasks them again
+   when it is done. */
 static void
 serial_interrupt (struct intr_frame *f UNUSED) 
 {
@@ -213,16 +229,50 @@ serial_interrupt (struct intr_frame *f UNUSED)
      occasionally miss an interrupt running under QEMU. */
   inb (IIR_REG);
 
-  /* As long as we have room to receive a byte, and the hardware
-     has a byte for us, receive a byte.  */
-  while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
-    input_putc (inb (RBR_REG));
+  outb (IER_REG, 0);
+  work_queue (&serial_work);
+}
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+/* Work function that receives and transmits what it can, then
+   re-enables the UART's interrupts.  Moves at most TRANSFER_CHUNK
+   bytes each way per interrupts-off section, so that a long
+   burst of input or output does not keep interrupts off for the
+   whole burst. */
+static void
+transfer (void *aux UNUSED) 
+{
+  bool more;
 
-  /* Update interrupt enable register based on queue status. */
-  write_ier ();
+  do
+    {
+      enum intr_level old_level = intr_disable ();
+      int i;
+
+      /* As long as we have room to receive a byte, and the
+         hardware has a byte for us, receive a byte.  */
+      for (i = 0; i < TRANSFER_CHUNK; i++)
+        if (input_full () || (inb (LSR_REG) & LSR_DR) == 0)
+          break;
+        else
+          input_putc (inb (RBR_REG));
+      more = i == TRANSFER_CHUNK;
+
+      /* As long as we have a byte to transmit, and the hardware
+         is ready to accept a byte for transmission, transmit a
+         byte. */
+      for (i = 0; i < TRANSFER_CHUNK; i++)
+        if (intq_empty (&txq) || (inb (LSR_REG) & LSR_THRE) == 0)
+          break;
+        else
+          outb (THR_REG, intq_getc (&txq));
+      more = more || i == TRANSFER_CHUNK;
+
+      /* Once we are done, update interrupt enable register based
+         on queue status. */
+      if (!more)
+        write_ier ();
+
+      intr_set_level (old_level);
+    }
+  while (more);
 }
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include "threads/interrupt.h"
 #include "threads/io.h"
+#include "threads/smp.h"
 #include "threads/synch.h"
 #include "threads/thread.h"
   
@@ -20,14 +21,93 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* List of threads sleeping in timer_sleep(), in order of
+   increasing wake_tick.  Threads with equal wake_tick values are
+   kept in the order in which they went to sleep. */
+static struct list sleep_list;
+
+/* Hierarchical timing wheel for timer events.
+
+   The wheel has WHEEL_LEVELS levels of WHEEL_SIZE slots each.
+   Level 0 has one slot per tick, and each slot at level L spans
+   WHEEL_SIZE**L ticks, so the wheel covers WHEEL_SIZE**WHEEL_LEVELS
+   ticks (about 46 hours at 100 Hz) in all.  An event goes into
+   the lowest level whose span reaches its expiration time.
+   Whenever level L wraps around to slot 0, the next slot of
+   level L + 1 is "cascaded": its events are reinserted, which
+   moves each of them down at least one level.  An event thus
+   moves at most WHEEL_LEVELS - 1 times before it expires, and
+   one due within WHEEL_SIZE ticks, the common case for a
+   timeout, never moves at all.  Events beyond the wheel's reach
+   wait in the farthest slot of the top level and are reinserted
+   until they come within it.
+
+   wheel_clock is the next tick to be processed.  It trails
+   `ticks' only while timer_interrupt() catches up after a
+   tickless idle period.  The wheel is protected by turning
+   interrupts off. */
+#define WHEEL_BITS 6
+#define WHEEL_SIZE (1 << WHEEL_BITS)
+#define WHEEL_MASK (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+static struct list wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static int64_t wheel_clock;
+static unsigned wheel_event_cnt;        /* # of pending events. */
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Clocksource for timer_now_ns(), the CPU's time-stamp counter.
+
+   timer_calibrate() counts TSC cycles over CALIBRATE_TICKS timer
+   ticks and derives a conversion from cycles to nanoseconds of
+   the form ns = cycles * tsc_mult / 2**tsc_shift, which needs no
+   division.  tsc_shift is chosen as large as possible for
+   precision, keeping tsc_mult in 32 bits.  The TSC counts at a
+   constant rate on the CPUs that we target, and the CPUs'
+   counters are assumed to be in step. */
+#define CALIBRATE_TICKS 5
+static uint64_t tsc_base;       /* TSC at tick 0 of calibration. */
+static int64_t ns_base;         /* timer_now_ns() at tsc_base. */
+static uint32_t tsc_mult;       /* Multiplier, or 0 if uncalibrated. */
+static int tsc_shift;           /* Shift. */
+static uint64_t tsc_hz;         /* TSC cycles per second. */
+
+/* 8254 input frequency, in Hz. */
+#define PIT_HZ 1193180
+
+/* Number of 8254 input clocks per timer tick. */
+static uint16_t pit_count;
+
+/* If true, the idle thread stops the periodic timer tick while
+   no thread is runnable.  Controlled by kernel command-line
+   option "-tickless". */
+bool timer_tickless;
+
+/* While the idle thread is halted in tickless mode, the 8254 is
+   in one-shot mode and these record what it was programmed
+   with: the number of input clocks until it fires and the number
+   of ticks that span.  oneshot_ticks is 0 in periodic mode. */
+static unsigned oneshot_count;
+static int64_t oneshot_ticks;
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
 static void real_time_sleep (int64_t num, int32_t denom);
+static void calibrate_tsc (void);
+static inline uint64_t rdtsc (void);
+static bool wake_tick_less (const struct list_elem *,
+                            const struct list_elem *, void *aux);
+static void wake_sleepers (void);
+static void wheel_insert (struct timer_event *);
+static void wheel_cascade (int level);
+static void run_timer_events (void);
+static int64_t wheel_idle_limit (int64_t idle_ticks);
+static void pit_configure (int mode, uint16_t count);
+static uint16_t pit_read_count (void);
+static bool pit_output (void);
 
 /* Sets up the 8254 Programmable Interval Timer (PIT) to
    interrupt PIT_FREQ times per second, and registers the
@@ -35,14 +115,18 @@ static void real_time_sleep (int64_t num, int32_t denom);
 void
 timer_init (void) 
 {
+  int level, slot;
+
   /* 8254 input frequency divided by TIMER_FREQ, rounded to
      nearest. */
-  uint16_t count = (1193180 + TIMER_FREQ / 2) / TIMER_FREQ;
-
-  outb (0x43, 0x34);    /* CW: counter 0, LSB then MSB, mode 2, binary. */
-  outb (0x40, count & 0xff);
-  outb (0x40, count >> 8);
+  pit_count = (PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ;
+  pit_configure (2, pit_count);
 
+  list_init (&sleep_list);
+  for (level = 0; level < WHEEL_LEVELS; level++)
+    for (slot = 0; slot < WHEEL_SIZE; slot++)
+      list_init (&wheel[level][slot]);
+  wheel_clock = ticks + 1;
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -70,17 +154,29 @@ timer_calibrate (void)
     if (!too_many_loops (high_bit | test_bit))
       loops_per_tick |= test_bit;
 
-  printf ("%'"PRIu64" loops/s.\n", (uint64_t) loops_per_tick * TIMER_FREQ);
+  printf ("%'"PRIu64" loops/s", (uint64_t) loops_per_tick * TIMER_FREQ);
+
+  calibrate_tsc ();
+  printf (", TSC at %'"PRIu64" Hz.\n", tsc_hz);
 }
 
-/* Returns the number of timer ticks since the OS booted. */
+/* Returns the number of timer ticks since the OS booted.  Does
+   not disable interrupts, so that the scheduler can call it with
+   spinlocks held. */
 int64_t
 timer_ticks (void) 
 {
-  enum intr_level old_level = intr_disable ();
-  int64_t t = ticks;
-  intr_set_level (old_level);
-  barrier ();
+  /* A timer interrupt between the two halves of a read of the
+     64-bit count can tear it, so read until two reads in a row
+     agree. */
+  int64_t t;
+
+  do 
+    {
+      t = ticks;
+      barrier ();
+    }
+  while (t != ticks);
   return t;
 }
 
@@ -92,15 +188,80 @@ timer_elapsed (int64_t then)
   return timer_ticks () - then;
 }
 
-/* Suspends execution for approximately TICKS timer ticks. */
+/* Returns the number of nanoseconds since the OS booted, from a
+   monotonic clock with much finer resolution than the timer
+   tick.  Does not disable interrupts, so it may be called from
+   any context, including an interrupt handler or code that is
+   timing an interrupts-off section.  Until timer_calibrate() has
+   run, the clock has only tick resolution. */
+int64_t
+timer_now_ns (void) 
+{
+  if (tsc_mult == 0) 
+    {
+      return timer_ticks () * (1000 * 1000 * 1000 / TIMER_FREQ);
+    }
+  return ns_base + timer_tsc_to_ns (rdtsc () - tsc_base);
+}
+
+/* Returns the number of nanoseconds elapsed since THEN, which
+   should be a value once returned by timer_now_ns(). */
+int64_t
+timer_elapsed_ns (int64_t then) 
+{
+  return timer_now_ns () - then;
+}
+
+/* Converts CYCLES, a difference between two readings of the
+   CPU's time-stamp counter, to nanoseconds.  Returns 0 until
+   timer_calibrate() has measured the TSC's frequency.  May be
+   called from any context. */
+int64_t
+timer_tsc_to_ns (uint64_t cycles) 
+{
+  uint32_t hi = cycles >> 32;
+  uint32_t lo = cycles;
+
+  /* Multiply the 64-bit cycle count by tsc_mult in two 32-bit
+     halves, so that the product cannot overflow. */
+  return ((((uint64_t) hi * tsc_mult) << (32 - tsc_shift))
+          + (((uint64_t) lo * tsc_mult) >> tsc_shift));
+}
+
+/* Suspends execution for approximately TICKS timer ticks.
+
+   The calling thread is blocked on sleep_list, so it consumes no
+   CPU time until timer_interrupt() wakes it. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
-
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  timer_sleep_until (timer_ticks () + ticks);
+}
+
+/* Suspends execution until the timer tick count reaches
+   WAKE_TICK, returning at once if it already has.  Unlike
+   timer_sleep(), may be called with interrupts off, in which
+   case they are still off on return. */
+void
+timer_sleep_until (int64_t wake_tick) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable ();
+  if (wake_tick > ticks) 
+    {
+      t->wake_tick = wake_tick;
+      list_insert_ordered (&sleep_list, &t->elem, wake_tick_less, NULL);
+      thread_block ();
+    }
+  intr_set_level (old_level);
 }
 
 /* Suspends execution for approximately MS milliseconds. */
@@ -124,6 +285,182 @@ timer_nsleep (int64_t ns)
   real_time_sleep (ns, 1000 * 1000 * 1000);
 }
 
+/* Initializes EV as a timer event that, whenever it expires,
+   calls FUNC, passing AUX, from the timer interrupt handler. */
+void
+timer_event_init (struct timer_event *ev, timer_func *func, void *aux) 
+{
+  ASSERT (ev != NULL);
+  ASSERT (func != NULL);
+
+  ev->func = func;
+  ev->aux = aux;
+  ev->pending = false;
+  ev->deferred = false;
+}
+
+/* Initializes EV as a timer event that, whenever it expires,
+   queues a call to FUNC, passing AUX, for the worker thread.
+   FUNC then runs with interrupts on and may sleep briefly. */
+void
+timer_event_init_deferred (struct timer_event *ev, timer_func *func,
+                           void *aux) 
+{
+  timer_event_init (ev, func, aux);
+  ev->deferred = true;
+  work_init (&ev->work, func, aux);
+}
+
+/* Arms EV to expire after TICKS timer ticks, or at the next tick
+   if TICKS is 0 or negative.  If EV is already pending, it is
+   re-armed: only the new expiration time counts.  Returns true
+   if EV was pending, false otherwise.
+
+   May be called from an interrupt handler, including from a
+   timer function, which may re-arm its own event. */
+bool
+timer_add (struct timer_event *ev, int64_t ticks_) 
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (ev != NULL);
+  ASSERT (ev->func != NULL);
+
+  old_level = intr_disable ();
+  was_pending = ev->pending;
+  if (was_pending)
+    list_remove (&ev->elem);
+  else
+    wheel_event_cnt++;
+  ev->expires = ticks + (ticks_ > 0 ? ticks_ : 1);
+  ev->pending = true;
+  wheel_insert (ev);
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Disarms EV.  Returns true if EV was pending, false if it had
+   already expired or was never armed.  In the latter case, for a
+   deferred event, EV's function might still be queued or
+   running in the worker thread. */
+bool
+timer_cancel (struct timer_event *ev) 
+{
+  enum intr_level old_level;
+  bool was_pending;
+
+  ASSERT (ev != NULL);
+
+  old_level = intr_disable ();
+  was_pending = ev->pending;
+  if (was_pending) 
+    {
+      list_remove (&ev->elem);
+      ev->pending = false;
+      wheel_event_cnt--;
+    }
+  intr_set_level (old_level);
+
+  return was_pending;
+}
+
+/* Returns true if EV is armed and has not yet expired. */
+bool
+timer_pending (const struct timer_event *ev) 
+{
+  ASSERT (ev != NULL);
+  return ev->pending;
+}
+
+/* Called by the idle thread, with interrupts off, just before it
+   halts the CPU.  In tickless mode, replaces the periodic tick by
+   a single interrupt at the next sleeper's wake time, so that a
+   CPU with nothing to do is not woken TIMER_FREQ times per
+   second.  The 8254's 16-bit counter limits a one-shot to a few
+   ticks, so a longer idle period costs an occasional wakeup.
+
+   The 8254 drives the system tick count for every CPU, so
+   tickless mode applies only while a single CPU is online. */
+void
+timer_idle_enter (void) 
+{
+  unsigned max_count, count;
+  int64_t idle_ticks;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (!timer_tickless || oneshot_ticks != 0 || cpu_cnt > 1)
+    return;
+
+  /* Find how many tick boundaries we may sleep through.  The
+     one-shot count starts with the part of the current tick that
+     remains, so that it expires on a tick boundary. */
+  count = pit_read_count ();
+  max_count = UINT16_MAX;
+  idle_ticks = 1 + (max_count - count) / pit_count;
+  if (!list_empty (&sleep_list)) 
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wake_tick - ticks < idle_ticks)
+        idle_ticks = t->wake_tick - ticks;
+    }
+  if (wheel_event_cnt > 0)
+    idle_ticks = wheel_idle_limit (idle_ticks);
+  if (thread_mlfqs && TIMER_FREQ - ticks % TIMER_FREQ < idle_ticks)
+    {
+      /* Don't skip the multi-level feedback queue scheduler's
+         once-per-second update in thread_tick(). */
+      idle_ticks = TIMER_FREQ - ticks % TIMER_FREQ;
+    }
+  if (idle_ticks <= 1)
+    return;
+
+  oneshot_count = count + (idle_ticks - 1) * pit_count;
+  oneshot_ticks = idle_ticks;
+  pit_configure (0, oneshot_count);
+}
+
+/* Called at the start of every external interrupt, with
+   interrupts off.  If the periodic tick was stopped by
+   timer_idle_enter(), reconstructs the tick count from the
+   number of 8254 clocks that have elapsed and restarts the
+   periodic tick. */
+void
+timer_idle_exit (void) 
+{
+  int64_t elapsed;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (oneshot_ticks == 0)
+    return;
+
+  if (pit_output ()) 
+    {
+      /* The one-shot fired.  Its interrupt is being handled or is
+         pending, and timer_interrupt() will count the final
+         tick itself. */
+      elapsed = oneshot_ticks - 1;
+    }
+  else 
+    {
+      /* Some other interrupt woke us first.  Count the whole
+         ticks that passed.  Rounding down keeps the count short
+         of the one-shot's final tick, which therefore always
+         goes through timer_interrupt().  The partial tick is
+         lost, since restarting the periodic tick below begins a
+         fresh tick period. */
+      unsigned clocks = oneshot_count - pit_read_count ();
+      elapsed = clocks / pit_count;
+    }
+
+  pit_configure (2, pit_count);
+  oneshot_ticks = 0;
+  ticks += elapsed;
+  thread_tick_skipped (elapsed);
+}
+
 /* Prints timer statistics. */
 void
 timer_print_stats (void) 
@@ -133,10 +470,182 @@ timer_print_stats (void)
 
 /* Timer interrupt handler. */
 static void
-timer_interrupt (struct intr_frame *args UNUSED)
+timer_interrupt (struct intr_frame *args)
 {
   ticks++;
-  thread_tick ();
+  wake_sleepers ();
+  run_timer_events ();
+  thread_tick (args);
+}
+
+/* Returns true if the thread owning list element A_ should wake
+   up before the one owning B_, false otherwise. */
+static bool
+wake_tick_less (const struct list_elem *a_, const struct list_elem *b_,
+                void *aux UNUSED) 
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->wake_tick < b->wake_tick;
+}
+
+/* Wakes up every thread on sleep_list whose wake_tick has
+   arrived.  Only the front of the list needs to be examined,
+   because the list is ordered by wake_tick. */
+static void
+wake_sleepers (void) 
+{
+  bool woke = false;
+
+  while (!list_empty (&sleep_list)) 
+    {
+      struct thread *t = list_entry (list_front (&sleep_list),
+                                     struct thread, elem);
+      if (t->wake_tick > ticks)
+        break;
+      list_pop_front (&sleep_list);
+      thread_unblock (t);
+      woke = true;
+    }
+
+  if (woke)
+    thread_test_preemption ();
+}
+
+/* Inserts pending event EV into the timing wheel, into the
+   lowest level that reaches EV's expiration time. */
+static void
+wheel_insert (struct timer_event *ev) 
+{
+  int64_t delta = ev->expires - wheel_clock;
+  int64_t expires = ev->expires;
+  int level;
+
+  ASSERT (delta >= 0);
+  for (level = 0; level < WHEEL_LEVELS - 1; level++)
+    if (delta < (1LL << (WHEEL_BITS * (level + 1))))
+      break;
+  if (delta >= (1LL << (WHEEL_BITS * WHEEL_LEVELS)))
+    expires = wheel_clock + (1LL << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+
+  list_push_back (&wheel[level][(expires >> (WHEEL_BITS * level))
+                                & WHEEL_MASK],
+                  &ev->elem);
+}
+
+/* Reinserts the events in the slot of level LEVEL that covers
+   wheel_clock.  If that slot is slot 0, also cascades the next
+   level first, so that its events reach this level in time. */
+static void
+wheel_cascade (int level) 
+{
+  int slot = (wheel_clock >> (WHEEL_BITS * level)) & WHEEL_MASK;
+  struct list *list = &wheel[level][slot];
+  struct list events;
+
+  if (slot == 0 && level + 1 < WHEEL_LEVELS)
+    wheel_cascade (level + 1);
+
+  list_init (&events);
+  list_splice (list_end (&events), list_begin (list), list_end (list));
+  while (!list_empty (&events)) 
+    {
+      struct list_elem *e = list_pop_front (&events);
+      wheel_insert (list_entry (e, struct timer_event, elem));
+    }
+}
+
+/* Processes each tick up to the current one, calling the
+   functions of the events that expire or queueing them for the
+   worker thread. */
+static void
+run_timer_events (void) 
+{
+  while (wheel_clock <= ticks) 
+    {
+      struct list *list;
+      struct list expired;
+
+      if (wheel_event_cnt == 0) 
+        {
+          wheel_clock = ticks + 1;
+          break;
+        }
+
+      /* Collect this tick's events before calling any of them,
+         so that an event re-armed by its own function cannot
+         land back in the list being run. */
+      if ((wheel_clock & WHEEL_MASK) == 0)
+        wheel_cascade (1);
+      list = &wheel[0][wheel_clock & WHEEL_MASK];
+      list_init (&expired);
+      list_splice (list_end (&expired), list_begin (list), list_end (list));
+      wheel_clock++;
+
+      while (!list_empty (&expired)) 
+        {
+          struct timer_event *ev
+            = list_entry (list_pop_front (&expired), struct timer_event, elem);
+
+          ASSERT (ev->expires < wheel_clock);
+          ev->pending = false;
+          wheel_event_cnt--;
+          if (ev->deferred)
+            work_queue (&ev->work);
+          else
+            ev->func (ev->aux);
+        }
+    }
+}
+
+/* Returns IDLE_TICKS, or less if a timer event might expire or
+   a level of the timing wheel needs cascading sooner than that.
+   Only level 0 has to be scanned, because an event in a higher
+   level cannot expire before the next cascade. */
+static int64_t
+wheel_idle_limit (int64_t idle_ticks) 
+{
+  int64_t t;
+
+  for (t = wheel_clock; t - ticks < idle_ticks; t++)
+    if (!list_empty (&wheel[0][t & WHEEL_MASK])
+        || (t & WHEEL_MASK) == 0)
+      return t - ticks;
+  return idle_ticks;
+}
+
+/* Programs 8254 counter 0 to run in the given MODE, counting
+   down from COUNT.  Mode 2 is the periodic rate generator, mode
+   0 fires a single interrupt when the count reaches zero. */
+static void
+pit_configure (int mode, uint16_t count) 
+{
+  /* CW: counter 0, LSB then MSB, MODE, binary. */
+  outb (0x43, 0x30 | (mode << 1));
+  outb (0x40, count & 0xff);
+  outb (0x40, count >> 8);
+}
+
+/* Returns the current value of 8254 counter 0. */
+static uint16_t
+pit_read_count (void) 
+{
+  uint8_t lo, hi;
+
+  outb (0x43, 0x00);    /* CW: counter 0, latch count. */
+  lo = inb (0x40);
+  hi = inb (0x40);
+  return lo | (hi << 8);
+}
+
+/* Returns the state of counter 0's OUT pin.  In mode 0, OUT goes
+   high when the count reaches zero and stays high. */
+static bool
+pit_output (void) 
+{
+  outb (0x43, 0xe2);    /* Read-back: counter 0 status only. */
+  return (inb (0x40) & 0x80) != 0;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -172,6 +681,49 @@ busy_wait (int64_t loops)
     barrier ();
 }
 
+/* Measures the TSC's frequency against the timer tick and sets
+   up timer_now_ns() to use the TSC. */
+static void
+calibrate_tsc (void) 
+{
+  int64_t start, ns;
+  uint64_t tsc_start, cycles;
+
+  /* Count cycles between two tick boundaries. */
+  start = ticks;
+  while (ticks == start)
+    barrier ();
+  start = ticks;
+  tsc_start = rdtsc ();
+  while (ticks - start < CALIBRATE_TICKS)
+    barrier ();
+  cycles = rdtsc () - tsc_start;
+  tsc_hz = cycles * TIMER_FREQ / CALIBRATE_TICKS;
+
+  /* Choose the conversion factor:
+     tsc_mult = 10**9 / tsc_hz * 2**tsc_shift < 2**32. */
+  for (tsc_shift = 32; tsc_shift > 0; tsc_shift--) 
+    {
+      uint64_t mult = (1000ULL * 1000 * 1000 << tsc_shift) / tsc_hz;
+      if (mult <= UINT32_MAX)
+        break;
+    }
+  ns = start * (1000 * 1000 * 1000 / TIMER_FREQ);
+  tsc_base = tsc_start;
+  ns_base = ns;
+  tsc_mult = (1000ULL * 1000 * 1000 << tsc_shift) / tsc_hz;
+}
+
+/* Returns the CPU's time-stamp counter.  See [IA32-v2b]
+   "RDTSC". */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
 /* Sleep for approximately NUM/DENOM seconds. */
 static void
 real_time_sleep (int64_t num, int32_t denom) 
@@ -185,18 +737,30 @@ real_time_sleep (int64_t num, int32_t denom)
   int64_t ticks = num * TIMER_FREQ / denom;
 
   ASSERT (intr_get_level () == INTR_ON);
-  if (ticks > 0)
+  if (tsc_mult != 0) 
+    {
+      /* Find the deadline on the high-resolution clock, then
+         sleep for the whole ticks, which yields the CPU to other
+         processes, and busy-wait for the fraction of a tick that
+         is left, for accurate timing. */
+      int64_t end = timer_now_ns () + num * (1000 * 1000 * 1000 / denom);
+
+      ASSERT ((1000 * 1000 * 1000) % denom == 0);
+      timer_sleep (ticks);
+      while (timer_now_ns () < end)
+        barrier ();
+    }
+  else if (ticks > 0)
     {
-      /* We're waiting for at least one full timer tick.  Use
-         timer_sleep() because it will yield the CPU to other
-         processes. */                
+      /* Before the clock is calibrated, we can only wait for
+         whole ticks. */
       timer_sleep (ticks); 
     }
   else 
     {
-      /* Otherwise, use a busy-wait loop for more accurate
-         sub-tick timing.  We scale the numerator and denominator
-         down by 1000 to avoid the possibility of overflow. */
+      /* Before the clock is calibrated, use a busy-wait loop.  We
+         scale the numerator and denominator down by 1000 to
+         avoid the possibility of overflow. */
       ASSERT (denom % 1000 == 0);
       busy_wait (loops_per_tick * num / 1000 * TIMER_FREQ / (denom / 1000)); 
     }
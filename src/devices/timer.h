@@ -1,8 +1,11 @@
 #ifndef DEVICES_TIMER_H
 #define DEVICES_TIMER_H
 
+#include <list.h>
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include "threads/workqueue.h"
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
@@ -12,12 +15,58 @@ void timer_calibrate (void);
 
 int64_t timer_ticks (void);
 int64_t timer_elapsed (int64_t);
+int64_t timer_now_ns (void);
+int64_t timer_elapsed_ns (int64_t);
+int64_t timer_tsc_to_ns (uint64_t cycles);
 
 void timer_sleep (int64_t ticks);
+void timer_sleep_until (int64_t wake_tick);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
 
+/* Kernel timers.
+
+   A timer event calls a function once, a given number of timer
+   ticks after it is armed with timer_add().  By default, the
+   function runs in the timer interrupt handler, so like any
+   interrupt handler it must not sleep and should be brief.  An
+   event initialized with timer_event_init_deferred() instead
+   queues its function for the worker thread (see workqueue.h).
+
+   Events are kept in a hierarchical timing wheel, so arming,
+   cancelling, and expiring an event each take constant time no
+   matter how many events are pending.
+
+   The caller owns the struct timer_event and must keep it in
+   memory while it is pending, and, for a deferred event, until
+   its function has run. */
+
+typedef void timer_func (void *aux);
+
+struct timer_event
+  {
+    struct list_elem elem;      /* Element in a timing wheel slot. */
+    int64_t expires;            /* Tick at which to expire. */
+    timer_func *func;           /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Armed and not yet expired? */
+    bool deferred;              /* Run FUNC in the worker thread? */
+    struct work work;           /* For running FUNC if DEFERRED. */
+  };
+
+void timer_event_init (struct timer_event *, timer_func *, void *aux);
+void timer_event_init_deferred (struct timer_event *, timer_func *,
+                                void *aux);
+bool timer_add (struct timer_event *, int64_t ticks);
+bool timer_cancel (struct timer_event *);
+bool timer_pending (const struct timer_event *);
+
+/* Tickless idle. */
+extern bool timer_tickless;
+void timer_idle_enter (void);
+void timer_idle_exit (void);
+
 void timer_print_stats (void);
 
 #endif /* devices/timer.h */
@@ -0,0 +1,18 @@
+#ifndef __LIB_CPU_USAGE_H
+#define __LIB_CPU_USAGE_H
+
+#include <stdint.h>
+
+/* CPU usage of a thread or, equivalently, of a user process,
+   which runs as a single thread.  Filled in by the kernel's
+   thread_get_usage() and by the cpu_usage system call. */
+struct cpu_usage
+  {
+    int64_t user_ticks;         /* Timer ticks while in user mode. */
+    int64_t kernel_ticks;       /* Timer ticks while in kernel mode. */
+    int64_t wait_ns;            /* Time ready to run but not running. */
+    uint32_t voluntary_cnt;     /* # of times it blocked or yielded. */
+    uint32_t involuntary_cnt;   /* # of times it was preempted. */
+  };
+
+#endif /* lib/cpu-usage.h */
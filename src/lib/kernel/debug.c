@@ -18,7 +18,9 @@ debug_panic (const char *file, int line, const char *function,
   static int level;
   va_list args;
 
-  intr_disable ();
+  /* Not intr_disable(): we may hold a spinlock that the holder
+     of the interrupt lock is waiting for. */
+  intr_disable_local ();
   console_panic ();
 
   level++;
@@ -0,0 +1,369 @@
+#include "rbtree.h"
+#include "../debug.h"
+
+/* Our red-black tree follows [CLRS] chapter 13, except that the
+   leaves are null pointers instead of a sentinel element.  Where
+   the book's deletion fixup would look up the parent of a leaf,
+   the parent is passed along explicitly instead.
+
+   A red-black tree satisfies these properties:
+
+     1. Every element is either red or black.
+
+     2. The root is black.
+
+     3. A red element's children are black (or null).
+
+     4. Every path from an element down to a null leaf passes
+        through the same number of black elements.
+
+   Together they ensure that no path from the root to a leaf is
+   more than twice as long as any other, so the height of a tree
+   of n elements is at most 2 lg(n + 1). */
+
+static bool is_red (const struct rb_elem *);
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void replace_child (struct rb_tree *, struct rb_elem *old,
+                           struct rb_elem *new);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+
+/* Initializes tree T as empty, to order its elements using LESS
+   given auxiliary data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux) 
+{
+  ASSERT (t != NULL);
+  ASSERT (less != NULL);
+
+  t->root = t->min = NULL;
+  t->elem_cnt = 0;
+  t->less = less;
+  t->aux = aux;
+}
+
+/* Inserts E into T, after any elements equal to it. */
+void
+rb_insert (struct rb_tree *t, struct rb_elem *e) 
+{
+  struct rb_elem **link = &t->root;
+  struct rb_elem *parent = NULL;
+  bool is_min = true;
+
+  ASSERT (t != NULL);
+  ASSERT (e != NULL);
+
+  /* Find the leaf where E belongs. */
+  while (*link != NULL) 
+    {
+      parent = *link;
+      if (t->less (e, parent, t->aux))
+        link = &parent->left;
+      else 
+        {
+          link = &parent->right;
+          is_min = false;
+        }
+    }
+
+  e->parent = parent;
+  e->left = e->right = NULL;
+  e->red = true;
+  *link = e;
+  if (is_min)
+    t->min = e;
+  t->elem_cnt++;
+
+  insert_fixup (t, e);
+}
+
+/* Removes E, which must be in T, from T. */
+void
+rb_remove (struct rb_tree *t, struct rb_elem *e) 
+{
+  struct rb_elem *child, *parent;
+  bool removed_red;
+
+  ASSERT (t != NULL);
+  ASSERT (e != NULL);
+  ASSERT (t->elem_cnt > 0);
+
+  if (t->min == e)
+    t->min = rb_next (e);
+
+  if (e->left == NULL || e->right == NULL) 
+    {
+      /* E has at most one child, which takes its place. */
+      child = e->left != NULL ? e->left : e->right;
+      parent = e->parent;
+      removed_red = e->red;
+      replace_child (t, e, child);
+    }
+  else 
+    {
+      /* E's successor S, which has no left child, takes E's
+         place, and S's right child takes S's. */
+      struct rb_elem *s = e->right;
+      while (s->left != NULL)
+        s = s->left;
+
+      removed_red = s->red;
+      child = s->right;
+      if (s->parent == e)
+        parent = s;
+      else 
+        {
+          parent = s->parent;
+          replace_child (t, s, child);
+          s->right = e->right;
+          s->right->parent = s;
+        }
+      replace_child (t, e, s);
+      s->left = e->left;
+      s->left->parent = s;
+      s->red = e->red;
+    }
+  t->elem_cnt--;
+
+  /* Removing a black element leaves one path short of a black
+     element. */
+  if (!removed_red)
+    remove_fixup (t, child, parent);
+}
+
+/* Returns the minimum element in T, or a null pointer if T is
+   empty.  Takes O(1) time. */
+struct rb_elem *
+rb_min (const struct rb_tree *t) 
+{
+  return t->min;
+}
+
+/* Returns the element that follows E in ascending order, or a
+   null pointer if E is the maximum element. */
+struct rb_elem *
+rb_next (const struct rb_elem *e) 
+{
+  ASSERT (e != NULL);
+
+  if (e->right != NULL) 
+    {
+      e = e->right;
+      while (e->left != NULL)
+        e = e->left;
+      return (struct rb_elem *) e;
+    }
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns the number of elements in T. */
+size_t
+rb_size (const struct rb_tree *t) 
+{
+  return t->elem_cnt;
+}
+
+/* Returns true if T contains no elements, false otherwise. */
+bool
+rb_empty (const struct rb_tree *t) 
+{
+  return t->root == NULL;
+}
+
+/* Returns true if E is red, false if it is black or null. */
+static bool
+is_red (const struct rb_elem *e) 
+{
+  return e != NULL && e->red;
+}
+
+/* Rotates left around X, so that X's right child takes X's place
+   and X becomes that child's left child. */
+static void
+rotate_left (struct rb_tree *t, struct rb_elem *x) 
+{
+  struct rb_elem *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  replace_child (t, x, y);
+  y->left = x;
+  x->parent = y;
+}
+
+/* Rotates right around X, so that X's left child takes X's place
+   and X becomes that child's right child. */
+static void
+rotate_right (struct rb_tree *t, struct rb_elem *x) 
+{
+  struct rb_elem *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  replace_child (t, x, y);
+  y->right = x;
+  x->parent = y;
+}
+
+/* Puts NEW, which may be null, in OLD's place as the child of
+   OLD's parent, or as the root of T if OLD is the root.  Does not
+   change OLD or NEW's children. */
+static void
+replace_child (struct rb_tree *t, struct rb_elem *old, struct rb_elem *new) 
+{
+  if (old->parent == NULL)
+    t->root = new;
+  else if (old == old->parent->left)
+    old->parent->left = new;
+  else
+    old->parent->right = new;
+  if (new != NULL)
+    new->parent = old->parent;
+}
+
+/* Restores the red-black properties after E, which is red, has
+   been inserted into T. */
+static void
+insert_fixup (struct rb_tree *t, struct rb_elem *e) 
+{
+  struct rb_elem *p;
+
+  /* While E and its parent are both red, violating property 3.
+     E's grandparent exists, because the root is black. */
+  while (is_red (p = e->parent)) 
+    {
+      struct rb_elem *g = p->parent;
+
+      if (p == g->left) 
+        {
+          struct rb_elem *u = g->right;
+          if (is_red (u)) 
+            {
+              /* Recolor and continue with the grandparent. */
+              p->red = u->red = false;
+              g->red = true;
+              e = g;
+            }
+          else 
+            {
+              if (e == p->right) 
+                {
+                  rotate_left (t, p);
+                  e = p;
+                  p = e->parent;
+                }
+              p->red = false;
+              g->red = true;
+              rotate_right (t, g);
+            }
+        }
+      else 
+        {
+          struct rb_elem *u = g->left;
+          if (is_red (u)) 
+            {
+              p->red = u->red = false;
+              g->red = true;
+              e = g;
+            }
+          else 
+            {
+              if (e == p->left) 
+                {
+                  rotate_right (t, p);
+                  e = p;
+                  p = e->parent;
+                }
+              p->red = false;
+              g->red = true;
+              rotate_left (t, g);
+            }
+        }
+    }
+  t->root->red = false;
+}
+
+/* Restores the red-black properties after the removal of a black
+   element from T left the paths through X, a child of PARENT,
+   one black element short.  X may be null. */
+static void
+remove_fixup (struct rb_tree *t, struct rb_elem *x, struct rb_elem *parent) 
+{
+  while (x != t->root && !is_red (x)) 
+    {
+      /* X's sibling W exists, because the paths through it have
+         at least one more black element than those through X. */
+      if (x == parent->left) 
+        {
+          struct rb_elem *w = parent->right;
+          if (w->red) 
+            {
+              w->red = false;
+              parent->red = true;
+              rotate_left (t, parent);
+              w = parent->right;
+            }
+          if (!is_red (w->left) && !is_red (w->right)) 
+            {
+              w->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else 
+            {
+              if (!is_red (w->right)) 
+                {
+                  w->left->red = false;
+                  w->red = true;
+                  rotate_right (t, w);
+                  w = parent->right;
+                }
+              w->red = parent->red;
+              parent->red = false;
+              w->right->red = false;
+              rotate_left (t, parent);
+              x = t->root;
+            }
+        }
+      else 
+        {
+          struct rb_elem *w = parent->left;
+          if (w->red) 
+            {
+              w->red = false;
+              parent->red = true;
+              rotate_right (t, parent);
+              w = parent->left;
+            }
+          if (!is_red (w->left) && !is_red (w->right)) 
+            {
+              w->red = true;
+              x = parent;
+              parent = x->parent;
+            }
+          else 
+            {
+              if (!is_red (w->left)) 
+                {
+                  w->right->red = false;
+                  w->red = true;
+                  rotate_left (t, w);
+                  w = parent->left;
+                }
+              w->red = parent->red;
+              parent->red = false;
+              w->left->red = false;
+              rotate_right (t, parent);
+              x = t->root;
+            }
+        }
+    }
+  if (x != NULL)
+    x->red = false;
+}
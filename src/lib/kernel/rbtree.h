@@ -0,0 +1,76 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A red-black tree is a binary search tree that keeps itself
+   balanced, so that insertion and deletion take O(lg n) time in
+   the worst case.  In addition, this implementation keeps track
+   of the tree's minimum element, which can be found in O(1)
+   time, which suits priority queues such as a scheduler's run
+   queue.
+
+   Like the linked list in list.h, the tree does no dynamic
+   allocation.  Each structure that can be in a tree must embed a
+   struct rb_elem member, and the rb_entry macro converts a
+   struct rb_elem back to the structure that contains it.  Refer
+   to lib/kernel/list.h for a detailed explanation.
+
+   Elements that compare equal are kept in the order they were
+   inserted: a new element goes after all the elements that are
+   equal to it. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Red-black tree element. */
+struct rb_elem 
+  {
+    struct rb_elem *parent;     /* Parent, or null at the root. */
+    struct rb_elem *left;       /* Left child, or null. */
+    struct rb_elem *right;      /* Right child, or null. */
+    bool red;                   /* Red if true, black if false. */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree 
+  {
+    struct rb_elem *root;       /* Root, or null if empty. */
+    struct rb_elem *min;        /* Minimum element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements in tree. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+/* Basic life cycle. */
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion, deletion. */
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+/* Traversal, in ascending order. */
+struct rb_elem *rb_min (const struct rb_tree *);
+struct rb_elem *rb_next (const struct rb_elem *);
+
+/* Information. */
+size_t rb_size (const struct rb_tree *);
+bool rb_empty (const struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
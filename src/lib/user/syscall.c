@@ -182,3 +182,9 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+cpu_usage (pid_t pid, struct cpu_usage *usage) 
+{
+  return syscall2 (SYS_CPU_USAGE, pid, usage);
+}
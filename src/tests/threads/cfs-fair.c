@@ -0,0 +1,84 @@
+/* Checks that the completely fair scheduler divides the CPU
+   between threads in proportion to their weights.
+
+   Two threads spin for 10 seconds, one with nice 0 and the other
+   with nice 5.  Their weights are 1024 and 335, so they should
+   receive about 753 and 247 of the 1,000 ticks, respectively.
+   Each must come within 50 ticks of its share. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 2
+#define SPIN_TICKS (10 * TIMER_FREQ)
+#define TOLERANCE 50
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+    int nice;
+  };
+
+static thread_func load_thread;
+
+void
+test_cfs_fair (void) 
+{
+  static const int nices[THREAD_CNT] = {0, 5};
+  static const int expected[THREAD_CNT] = {753, 247};
+  struct thread_info info[THREAD_CNT];
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_cfs);
+
+  start_time = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tick_count = 0;
+      ti->nice = nices[i];
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+
+  msg ("Sleeping 15 seconds to let threads run, please wait...");
+  timer_sleep (15 * TIMER_FREQ);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int diff = info[i].tick_count - expected[i];
+      if (diff < -TOLERANCE || diff > TOLERANCE)
+        fail ("Thread %d (nice %d) received %d ticks, expected %d.",
+              i, nices[i], info[i].tick_count, expected[i]);
+      msg ("Thread %d (nice %d) received its share.", i, nices[i]);
+    }
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 2 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + SPIN_TICKS;
+  int64_t last_time = 0;
+
+  thread_set_nice (ti->nice);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(cfs-fair) begin
+(cfs-fair) Sleeping 15 seconds to let threads run, please wait...
+(cfs-fair) Thread 0 (nice 0) received its share.
+(cfs-fair) Thread 1 (nice 5) received its share.
+(cfs-fair) end
+EOF
+pass;
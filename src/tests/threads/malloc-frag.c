@@ -0,0 +1,72 @@
+/* Measures how much of the kernel pool malloc() can hand out.
+
+   Counts the free pages in the kernel pool, then allocates
+   blocks until malloc() fails, cycling through a mix of sizes
+   like those of a file-heavy workload: in-memory inodes,
+   sector-sized and odd-sized buffers, and small strings.  The
+   bytes requested must add up to at least 70% of the pages that
+   were free.  Rounding every request up to a power of 2, and
+   giving every request over 1 kB a page of its own, would
+   manage less than 40% for this mix. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Request sizes, in bytes. */
+static const size_t sizes[] = {540, 1100, 24, 300, 72, 1500, 130, 700};
+#define SIZE_CNT (sizeof sizes / sizeof *sizes)
+
+/* Minimum acceptable utilization, in percent. */
+#define MIN_UTILIZATION 70
+
+void
+test_malloc_frag (void) 
+{
+  void *head, *p;
+  size_t page_cnt, requested, block_cnt;
+  size_t utilization;
+
+  /* Count the free pages by allocating all of them, linking each
+     to the previous one, then free them. */
+  head = NULL;
+  for (page_cnt = 0; (p = palloc_get_page (0)) != NULL; page_cnt++) 
+    {
+      *(void **) p = head;
+      head = p;
+    }
+  while (head != NULL) 
+    {
+      p = head;
+      head = *(void **) p;
+      palloc_free_page (p);
+    }
+
+  /* Allocate blocks until we run out, linked the same way. */
+  requested = 0;
+  for (block_cnt = 0; ; block_cnt++) 
+    {
+      size_t size = sizes[block_cnt % SIZE_CNT];
+      p = malloc (size);
+      if (p == NULL)
+        break;
+      *(void **) p = head;
+      head = p;
+      requested += size;
+    }
+  while (head != NULL) 
+    {
+      p = head;
+      head = *(void **) p;
+      free (p);
+    }
+
+  utilization = requested / (page_cnt * (PGSIZE / 100));
+  if (utilization < MIN_UTILIZATION)
+    fail ("%zu blocks used %zu%% of %zu pages, expected at least %d%%",
+          block_cnt, utilization, page_cnt, MIN_UTILIZATION);
+  msg ("Utilization is at least %d%%.", MIN_UTILIZATION);
+}
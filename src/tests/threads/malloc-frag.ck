@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc-frag) begin
+(malloc-frag) Utilization is at least 70%.
+(malloc-frag) end
+EOF
+pass;
@@ -0,0 +1,72 @@
+/* Checks that the page allocator merges freed blocks back
+   together.
+
+   Finds the largest power-of-two run of kernel pages that can be
+   allocated, then allocates and frees many runs of mixed sizes,
+   freeing them in an order that leaves holes behind until the
+   very end.  Once everything is freed, a run of the original
+   size must be available again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+
+#define BLOCK_CNT 64
+#define ROUND_CNT 8
+
+void
+test_palloc_coalesce (void) 
+{
+  static void *blocks[BLOCK_CNT];
+  static size_t sizes[BLOCK_CNT];
+  size_t largest;
+  void *p;
+  int round, i;
+
+  /* Find the largest power of two that we can allocate. */
+  for (largest = 1; ; largest *= 2) 
+    {
+      p = palloc_get_multiple (0, largest * 2);
+      if (p == NULL)
+        break;
+      palloc_free_multiple (p, largest * 2);
+    }
+  p = palloc_get_multiple (0, largest);
+  ASSERT (p != NULL);
+  palloc_free_multiple (p, largest);
+
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      /* Allocate runs of 1 to 7 pages. */
+      for (i = 0; i < BLOCK_CNT; i++) 
+        {
+          sizes[i] = (i * 5 + round) % 7 + 1;
+          blocks[i] = palloc_get_multiple (PAL_ZERO, sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("round %d: allocating %zu pages failed", round, sizes[i]);
+        }
+
+      /* Free the odd ones, then reallocate them at other sizes
+         into the holes, then free everything, evens first. */
+      for (i = 1; i < BLOCK_CNT; i += 2)
+        palloc_free_multiple (blocks[i], sizes[i]);
+      for (i = 1; i < BLOCK_CNT; i += 2) 
+        {
+          sizes[i] = (i + round) % 3 + 1;
+          blocks[i] = palloc_get_multiple (0, sizes[i]);
+          if (blocks[i] == NULL)
+            fail ("round %d: reallocating %zu pages failed", round, sizes[i]);
+        }
+      for (i = 0; i < BLOCK_CNT; i += 2)
+        palloc_free_multiple (blocks[i], sizes[i]);
+      for (i = 1; i < BLOCK_CNT; i += 2)
+        palloc_free_multiple (blocks[i], sizes[i]);
+    }
+
+  p = palloc_get_multiple (0, largest);
+  if (p == NULL)
+    fail ("could not allocate %zu pages after freeing everything", largest);
+  palloc_free_multiple (p, largest);
+  msg ("Largest run still available after %d rounds.", ROUND_CNT);
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-coalesce) begin
+(palloc-coalesce) Largest run still available after 8 rounds.
+(palloc-coalesce) end
+EOF
+pass;
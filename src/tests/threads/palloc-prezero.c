@@ -0,0 +1,78 @@
+/* Checks the reserve of zeroed pages that the idle thread keeps.
+
+   Sleeps so that the idle thread can fill the reserve, then
+   allocates pages with PAL_ZERO, dirtying and freeing them in
+   between, checking that each one is entirely zero.  Then checks
+   that the reserve does not reduce the number of pages that can
+   be allocated: after another sleep to refill it, allocating
+   without PAL_ZERO must still obtain as many pages as before. */
+
+#include <stdio.h>
+#include <string.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+#define ROUND_CNT 256
+
+static size_t count_free_pages (void);
+
+void
+test_palloc_prezero (void) 
+{
+  size_t before, after;
+  int round;
+
+  before = count_free_pages ();
+  timer_sleep (10);
+
+  for (round = 0; round < ROUND_CNT; round++) 
+    {
+      uint8_t *page = palloc_get_page (PAL_ZERO);
+      size_t i;
+
+      if (page == NULL)
+        fail ("round %d: out of pages", round);
+      for (i = 0; i < PGSIZE; i++)
+        if (page[i] != 0)
+          fail ("round %d: byte %zu of page is %#x", round, i, page[i]);
+      memset (page, 0x5a, PGSIZE);
+      palloc_free_page (page);
+
+      /* Give the idle thread a chance to run now and then. */
+      if (round % 32 == 0)
+        timer_sleep (1);
+    }
+  msg ("Every page was zeroed.");
+
+  timer_sleep (10);
+  after = count_free_pages ();
+  if (after != before)
+    fail ("%zu pages could be allocated at first, but %zu later",
+          before, after);
+  msg ("The zeroed pages were still available.");
+}
+
+/* Allocates every page in the kernel pool, without PAL_ZERO,
+   frees them, and returns how many there were. */
+static size_t
+count_free_pages (void) 
+{
+  void *head = NULL, *page;
+  size_t page_cnt;
+
+  for (page_cnt = 0; (page = palloc_get_page (0)) != NULL; page_cnt++) 
+    {
+      *(void **) page = head;
+      head = page;
+    }
+  while (head != NULL) 
+    {
+      page = head;
+      head = *(void **) page;
+      palloc_free_page (page);
+    }
+  return page_cnt;
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(palloc-prezero) begin
+(palloc-prezero) Every page was zeroed.
+(palloc-prezero) The zeroed pages were still available.
+(palloc-prezero) end
+EOF
+pass;
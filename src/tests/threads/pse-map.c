@@ -0,0 +1,84 @@
+/* Checks the kernel's 4 MB page mappings, run with 32 MB of RAM.
+
+   paging_init() maps each whole 4 MB of RAM above the first with
+   a single page directory entry that has PTE_PS set, if the CPU
+   supports it, which QEMU and Bochs both do.  Checks that CR4.PSE
+   is on, that each of those PDEs is the one pde_create_large()
+   makes for its address, and that a page allocated from above 4 MB
+   can be written and read back through its PDE, including after
+   its TLB entry is flushed.
+
+   The APs set CR4 from the BSP's value in ap-start.S; that path is
+   not covered here. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/vaddr.h"
+
+/* CR4 bit that enables 4 MB pages. */
+#define CR4_PSE 0x00000010
+
+/* Least amount of RAM that leaves several 4 MB pages to check. */
+#define MIN_RAM (4 * PTSPAN)
+
+static void check_page (uint32_t *page);
+
+void
+test_pse_map (void) 
+{
+  size_t ram_bytes = ram_pages * PGSIZE;
+  uintptr_t paddr;
+  uint32_t cr4;
+  uint32_t *page;
+
+  if (ram_bytes < MIN_RAM)
+    fail ("only %zu kB of RAM; run with -m 32", ram_bytes / 1024);
+
+  asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+  if (!(cr4 & CR4_PSE))
+    fail ("CR4.PSE is off");
+
+  for (paddr = PTSPAN; paddr + PTSPAN <= ram_bytes; paddr += PTSPAN) 
+    {
+      void *vaddr = ptov (paddr);
+      uint32_t pde = base_page_dir[pd_no (vaddr)];
+
+      if (pde != pde_create_large (vaddr, true))
+        fail ("PDE for physical address %#"PRIxPTR" is %#"PRIx32", "
+              "not %#"PRIx32, paddr, pde, pde_create_large (vaddr, true));
+    }
+  msg ("RAM above 4 MB is mapped with 4 MB pages.");
+
+  /* The user pool lies above the kernel pool, in the upper half
+     of RAM. */
+  page = palloc_get_page (PAL_USER);
+  if (page == NULL)
+    fail ("out of user pages");
+  if (vtop (page) < PTSPAN
+      || vtop (page) + PGSIZE > ram_bytes / PTSPAN * PTSPAN)
+    fail ("page at physical address %#"PRIxPTR" is not in a 4 MB page",
+          vtop (page));
+  check_page (page);
+  palloc_free_page (page);
+  msg ("Memory above 4 MB can be written and read back.");
+}
+
+/* Fills PAGE with a pattern, flushes its TLB entry so that the
+   CPU walks the page directory again, and checks the pattern. */
+static void
+check_page (uint32_t *page) 
+{
+  size_t word_cnt = PGSIZE / sizeof *page;
+  size_t i;
+
+  for (i = 0; i < word_cnt; i++)
+    page[i] = (uint32_t) vtop (&page[i]) ^ 0xa5a5a5a5;
+  asm volatile ("invlpg (%0)" : : "r" (page) : "memory");
+  for (i = 0; i < word_cnt; i++)
+    if (page[i] != ((uint32_t) vtop (&page[i]) ^ 0xa5a5a5a5))
+      fail ("word %zu of page reads %#"PRIx32, i, page[i]);
+}
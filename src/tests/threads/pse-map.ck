@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pse-map) begin
+(pse-map) RAM above 4 MB is mapped with 4 MB pages.
+(pse-map) Memory above 4 MB can be written and read back.
+(pse-map) end
+EOF
+pass;
@@ -0,0 +1,107 @@
+/* Checks earliest-deadline-first scheduling of real-time
+   threads.
+
+   First, two periodic real-time threads are admitted and a
+   third, which would push their total utilization past 1, is
+   refused.  The periodic threads then run alongside an ordinary
+   thread of priority PRI_MAX that never blocks, and must still
+   meet every deadline.
+
+   Finally, a real-time "hog" thread tries to run far past its
+   budget, which must not keep the main thread from running. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define PERIOD_CNT 5
+
+struct periodic 
+  {
+    int periods;                /* # of periods run. */
+    int misses;                 /* # of deadlines missed. */
+    struct semaphore done;      /* Upped when finished. */
+  };
+
+static thread_func periodic_thread;
+static thread_func spin_thread;
+static thread_func hog_thread;
+static void spin (int64_t ticks);
+
+static volatile bool hog_done;
+
+void
+test_rt_edf (void) 
+{
+  struct periodic a, b;
+  struct semaphore hog_sema;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&a.done, 0);
+  sema_init (&b.done, 0);
+  ASSERT (thread_create_rt ("rt-a", 10, 3, periodic_thread, &a) != TID_ERROR);
+  ASSERT (thread_create_rt ("rt-b", 20, 8, periodic_thread, &b) != TID_ERROR);
+  if (thread_create_rt ("rt-c", 5, 2, periodic_thread, NULL) == TID_ERROR)
+    msg ("rt-c refused.");
+
+  /* Runs until the periodic threads are done. */
+  thread_create ("spin", PRI_MAX, spin_thread, NULL);
+
+  sema_down (&a.done);
+  sema_down (&b.done);
+  msg ("rt-a: %d periods, %d deadlines missed.", a.periods, a.misses);
+  msg ("rt-b: %d periods, %d deadlines missed.", b.periods, b.misses);
+
+  /* The hog runs as soon as it is created, but it only gets 2
+     ticks of every 10. */
+  sema_init (&hog_sema, 0);
+  hog_done = false;
+  ASSERT (thread_create_rt ("hog", 10, 2, hog_thread, &hog_sema) != TID_ERROR);
+  if (!hog_done)
+    msg ("Main thread ran while the hog was throttled.");
+  sema_down (&hog_sema);
+}
+
+static void
+periodic_thread (void *p_) 
+{
+  struct periodic *p = p_;
+
+  for (p->periods = 0; p->periods < PERIOD_CNT; p->periods++) 
+    {
+      spin (1);
+      thread_rt_wait_period ();
+    }
+  p->misses = thread_rt_get_misses ();
+  sema_up (&p->done);
+}
+
+static void
+spin_thread (void *aux UNUSED) 
+{
+  spin (20 * PERIOD_CNT);
+}
+
+static void
+hog_thread (void *hog_sema_) 
+{
+  struct semaphore *hog_sema = hog_sema_;
+
+  spin (20);
+  hog_done = true;
+  sema_up (hog_sema);
+}
+
+/* Busy-waits until TICKS timer ticks have passed. */
+static void
+spin (int64_t ticks) 
+{
+  int64_t start = timer_ticks ();
+  while (timer_elapsed (start) < ticks)
+    continue;
+}
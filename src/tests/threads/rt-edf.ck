@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rt-edf) begin
+(rt-edf) rt-c refused.
+(rt-edf) rt-a: 5 periods, 0 deadlines missed.
+(rt-edf) rt-b: 5 periods, 0 deadlines missed.
+(rt-edf) Main thread ran while the hog was throttled.
+(rt-edf) end
+EOF
+pass;
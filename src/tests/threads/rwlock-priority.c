@@ -0,0 +1,56 @@
+/* Checks writer preference and priority in reader-writer locks.
+
+   While the main thread holds a reader-writer lock for reading,
+   a writer starts waiting for it.  A reader of lower priority
+   than the writer must then wait behind the writer, but a reader
+   of higher priority gets in at once.  When the main thread
+   releases the lock, it goes to the writer, and then to the
+   waiting reader. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+static thread_func reader_thread;
+static thread_func writer_thread;
+static struct rwlock rw;
+
+void
+test_rwlock_priority (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  rwlock_init (&rw);
+  rwlock_acquire_read (&rw);
+  msg ("main: reading.");
+
+  thread_create ("writer", PRI_DEFAULT + 2, writer_thread, NULL);
+  thread_create ("low reader", PRI_DEFAULT + 1, reader_thread, NULL);
+  thread_create ("high reader", PRI_DEFAULT + 3, reader_thread, NULL);
+
+  msg ("main: releasing.");
+  rwlock_release_read (&rw);
+  msg ("main: done.");
+}
+
+static void
+reader_thread (void *aux UNUSED) 
+{
+  msg ("%s: waiting.", thread_name ());
+  rwlock_acquire_read (&rw);
+  msg ("%s: reading.", thread_name ());
+  rwlock_release_read (&rw);
+}
+
+static void
+writer_thread (void *aux UNUSED) 
+{
+  msg ("writer: waiting.");
+  rwlock_acquire_write (&rw);
+  msg ("writer: writing.");
+  rwlock_release_write (&rw);
+  msg ("writer: done.");
+}
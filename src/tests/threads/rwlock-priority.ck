@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-priority) begin
+(rwlock-priority) main: reading.
+(rwlock-priority) writer: waiting.
+(rwlock-priority) low reader: waiting.
+(rwlock-priority) high reader: waiting.
+(rwlock-priority) high reader: reading.
+(rwlock-priority) main: releasing.
+(rwlock-priority) writer: writing.
+(rwlock-priority) writer: done.
+(rwlock-priority) low reader: reading.
+(rwlock-priority) main: done.
+(rwlock-priority) end
+EOF
+pass;
@@ -0,0 +1,67 @@
+/* Checks that readers share a reader-writer lock.
+
+   While the main thread holds the lock for writing, three
+   readers wait for it.  When it is released, all three must be
+   able to hold it at once.  Once they have all released it, the
+   main thread must be able to write again. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define READER_CNT 3
+
+/* Shared between the main thread and the readers. */
+struct rwlock_test 
+  {
+    struct rwlock rw;           /* The lock under test. */
+    struct semaphore entered;   /* Upped by each reader when it has
+                                   acquired the lock. */
+    struct semaphore leave;     /* Upped to let a reader release it. */
+  };
+
+static thread_func reader_thread;
+
+void
+test_rwlock_readers (void) 
+{
+  struct rwlock_test test;
+  int i;
+
+  rwlock_init (&test.rw);
+  sema_init (&test.entered, 0);
+  sema_init (&test.leave, 0);
+
+  /* Give the readers a chance to start waiting. */
+  rwlock_acquire_write (&test.rw);
+  for (i = 0; i < READER_CNT; i++)
+    thread_create ("reader", PRI_DEFAULT, reader_thread, &test);
+  thread_yield ();
+  rwlock_release_write (&test.rw);
+
+  for (i = 0; i < READER_CNT; i++)
+    sema_down (&test.entered);
+  if (test.rw.readers != READER_CNT)
+    fail ("%d readers hold the lock, not %d", test.rw.readers, READER_CNT);
+  msg ("%d readers hold the lock at once.", READER_CNT);
+  for (i = 0; i < READER_CNT; i++)
+    sema_up (&test.leave);
+
+  rwlock_acquire_write (&test.rw);
+  if (test.rw.readers != 0)
+    fail ("writer got the lock with %d readers", test.rw.readers);
+  rwlock_release_write (&test.rw);
+  msg ("Writer got the lock after the readers left.");
+}
+
+static void
+reader_thread (void *test_) 
+{
+  struct rwlock_test *test = test_;
+
+  rwlock_acquire_read (&test->rw);
+  sema_up (&test->entered);
+  sema_down (&test->leave);
+  rwlock_release_read (&test->rw);
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(rwlock-readers) begin
+(rwlock-readers) 3 readers hold the lock at once.
+(rwlock-readers) Writer got the lock after the readers left.
+(rwlock-readers) end
+EOF
+pass;
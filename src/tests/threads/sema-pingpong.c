@@ -0,0 +1,45 @@
+/* Makes control "ping-pong" between a pair of threads through
+   two semaphores, ten times in each direction. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUND_CNT 10
+
+static thread_func helper_thread;
+static int rounds;
+
+void
+test_sema_pingpong (void) 
+{
+  struct semaphore sema[2];
+  int i;
+
+  sema_init (&sema[0], 0);
+  sema_init (&sema[1], 0);
+  thread_create ("helper", PRI_DEFAULT, helper_thread, &sema);
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      sema_up (&sema[0]);
+      sema_down (&sema[1]);
+      if (rounds != i + 1)
+        fail ("after round %d, helper has done %d rounds", i + 1, rounds);
+    }
+  msg ("Control passed back and forth %d times.", ROUND_CNT);
+}
+
+static void
+helper_thread (void *sema_) 
+{
+  struct semaphore *sema = sema_;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      sema_down (&sema[0]);
+      rounds++;
+      sema_up (&sema[1]);
+    }
+}
@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sema-pingpong) begin
+(sema-pingpong) Control passed back and forth 10 times.
+(sema-pingpong) end
+EOF
+pass;
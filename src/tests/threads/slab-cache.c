@@ -0,0 +1,108 @@
+/* Checks the slab allocator.
+
+   Creates a colored cache of odd-sized, 32-byte aligned objects
+   with a constructor, and allocates several slabs' worth of
+   objects.  Each object must be aligned, constructed, and
+   distinct from the others, and different slabs should start
+   their objects at different colors.  Then frees every object
+   and reallocates a slab's worth, checking that the objects come
+   back in their constructed state without another call to the
+   constructor. */
+
+#include <stdio.h>
+#include <stdint.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/slab.h"
+#include "threads/vaddr.h"
+
+#define OBJ_SIZE 100
+#define OBJ_ALIGN 32
+#define SLAB_CNT 4
+#define MAX_OBJS 256
+
+/* Value stored by the constructor. */
+#define OBJ_MAGIC 0x0b1ec7ed
+
+struct obj 
+  {
+    unsigned magic;
+    unsigned owner;
+    uint8_t pad[OBJ_SIZE - 2 * sizeof (unsigned)];
+  };
+
+static kmem_ctor_func obj_ctor;
+static int ctor_cnt;
+
+void
+test_slab_cache (void) 
+{
+  static struct obj *objs[MAX_OBJS];
+  struct kmem_cache *c;
+  size_t per_slab, obj_cnt, i;
+  bool colored = false;
+  int ctors;
+
+  c = kmem_cache_create ("test", sizeof (struct obj), OBJ_ALIGN,
+                         obj_ctor, KMEM_COLOR);
+  ASSERT (c != NULL);
+  per_slab = kmem_cache_objs_per_slab (c);
+  obj_cnt = per_slab * SLAB_CNT;
+  ASSERT (obj_cnt <= MAX_OBJS);
+
+  for (i = 0; i < obj_cnt; i++) 
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL)
+        fail ("allocating object %zu failed", i);
+      if ((uintptr_t) objs[i] % OBJ_ALIGN != 0)
+        fail ("object %zu at %p is misaligned", i, objs[i]);
+      if (objs[i]->magic != OBJ_MAGIC)
+        fail ("object %zu was not constructed", i);
+      objs[i]->owner = i;
+    }
+  ctors = ctor_cnt;
+  msg ("Allocated %d slabs of objects.", SLAB_CNT);
+
+  for (i = 0; i < obj_cnt; i++)
+    if (objs[i]->owner != i)
+      fail ("object %zu overlaps object %u", i, objs[i]->owner);
+
+  /* Each slab hands out its objects in address order, so
+     OBJS[I * PER_SLAB] is the first object in slab I. */
+  for (i = 1; i < SLAB_CNT; i++)
+    if (pg_ofs (objs[i * per_slab]) != pg_ofs (objs[0]))
+      colored = true;
+  if (!colored)
+    fail ("every slab has the same color");
+
+  /* Free everything.  The cache keeps one empty slab, so a
+     slab's worth of objects can be reallocated from it without
+     running the constructor again. */
+  for (i = 0; i < obj_cnt; i++) 
+    {
+      objs[i]->owner = 0;
+      kmem_cache_free (c, objs[i]);
+    }
+  for (i = 0; i < per_slab; i++) 
+    {
+      objs[i] = kmem_cache_alloc (c);
+      if (objs[i] == NULL || objs[i]->magic != OBJ_MAGIC)
+        fail ("reallocated object %zu is not constructed", i);
+    }
+  if (ctor_cnt != ctors)
+    fail ("constructor called %d more times", ctor_cnt - ctors);
+  msg ("Reallocated objects without constructing them again.");
+
+  for (i = 0; i < per_slab; i++)
+    kmem_cache_free (c, objs[i]);
+  kmem_cache_destroy (c);
+}
+
+static void
+obj_ctor (void *obj_) 
+{
+  struct obj *obj = obj_;
+  obj->magic = OBJ_MAGIC;
+  ctor_cnt++;
+}
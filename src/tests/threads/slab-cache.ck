@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slab-cache) begin
+(slab-cache) Allocated 4 slabs of objects.
+(slab-cache) Reallocated objects without constructing them again.
+(slab-cache) end
+EOF
+pass;
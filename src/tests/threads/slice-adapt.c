@@ -0,0 +1,104 @@
+/* Checks that time slices adapt to thread behavior, run with
+   "-slice-adapt".
+
+   A thread that spins for a second uses up one time slice after
+   another, so its slice should grow to the maximum.  A thread
+   that sleeps over and over blocks before its slice is up, so
+   its slice should shrink to the minimum.  A thread that blocks
+   on a lock held by another thread should keep its slice. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+struct slice_info 
+  {
+    unsigned start_slice;       /* Slice at the start. */
+    unsigned slice;             /* Slice at the end. */
+    struct lock lock;           /* Lock for lock_thread() to wait on. */
+    struct semaphore done;      /* Upped when finished. */
+  };
+
+static thread_func cpu_thread;
+static thread_func io_thread;
+static thread_func lock_thread;
+
+void
+test_slice_adapt (void) 
+{
+  struct slice_info info;
+
+  /* This test does not work with the completely fair scheduler,
+     which does not use time slices. */
+  ASSERT (!thread_cfs);
+  ASSERT (thread_slice_adapt);
+
+  sema_init (&info.done, 0);
+  thread_create ("cpu", PRI_DEFAULT, cpu_thread, &info);
+  sema_down (&info.done);
+  if (info.slice == thread_slice_max)
+    msg ("CPU-bound thread's slice grew to the maximum.");
+  else
+    fail ("CPU-bound thread's slice is %u, not %u.",
+          info.slice, thread_slice_max);
+
+  thread_create ("io", PRI_DEFAULT, io_thread, &info);
+  sema_down (&info.done);
+  if (info.slice == thread_slice_min)
+    msg ("I/O-bound thread's slice shrank to the minimum.");
+  else
+    fail ("I/O-bound thread's slice is %u, not %u.",
+          info.slice, thread_slice_min);
+
+  /* The higher-priority thread blocks on the lock at once, then
+     gets it when we release it. */
+  lock_init (&info.lock);
+  lock_acquire (&info.lock);
+  thread_create ("lock", PRI_DEFAULT + 1, lock_thread, &info);
+  lock_release (&info.lock);
+  sema_down (&info.done);
+  if (info.slice == info.start_slice)
+    msg ("Thread that waited for a lock kept its slice.");
+  else
+    fail ("Thread that waited for a lock has slice %u, not %u.",
+          info.slice, info.start_slice);
+}
+
+static void
+cpu_thread (void *info_) 
+{
+  struct slice_info *info = info_;
+  int64_t start = timer_ticks ();
+
+  while (timer_elapsed (start) < TIMER_FREQ)
+    continue;
+  info->slice = thread_current ()->slice;
+  sema_up (&info->done);
+}
+
+static void
+io_thread (void *info_) 
+{
+  struct slice_info *info = info_;
+  int i;
+
+  for (i = 0; i < 10; i++)
+    timer_sleep (1);
+  info->slice = thread_current ()->slice;
+  sema_up (&info->done);
+}
+
+static void
+lock_thread (void *info_) 
+{
+  struct slice_info *info = info_;
+
+  info->start_slice = thread_current ()->slice;
+  lock_acquire (&info->lock);
+  lock_release (&info->lock);
+  info->slice = thread_current ()->slice;
+  sema_up (&info->done);
+}
@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(slice-adapt) begin
+(slice-adapt) CPU-bound thread's slice grew to the maximum.
+(slice-adapt) I/O-bound thread's slice shrank to the minimum.
+(slice-adapt) Thread that waited for a lock kept its slice.
+(slice-adapt) end
+EOF
+pass;
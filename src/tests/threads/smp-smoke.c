@@ -0,0 +1,101 @@
+/* Smoke test for multiprocessor support, run with two CPUs.
+
+   Checks that the second CPU came online, then starts four
+   threads that each add to a shared counter many times, under a
+   lock, for about 2 seconds.  The lock must keep every increment,
+   and with four busy threads and two run queues, both CPUs must
+   have run some of them. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 4
+#define CPU_CNT 2
+#define SPIN_TICKS (2 * TIMER_FREQ)
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int increments;             /* # of times added to counter. */
+    bool ran_on[CPU_MAX];       /* CPUs this thread ran on. */
+    struct semaphore done;
+  };
+
+static thread_func counter_thread;
+static struct lock counter_lock;
+static long long counter;
+
+void
+test_smp_smoke (void) 
+{
+  struct thread_info info[THREAD_CNT];
+  bool ran_on[CPU_MAX] = {false};
+  long long total = 0;
+  int64_t start_time;
+  int i, j;
+
+  if (cpu_cnt != CPU_CNT)
+    fail ("%d CPUs online, expected %d", cpu_cnt, CPU_CNT);
+  msg ("%d CPUs online.", cpu_cnt);
+
+  lock_init (&counter_lock);
+  counter = 0;
+  start_time = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+      int k;
+
+      ti->start_time = start_time;
+      ti->increments = 0;
+      for (k = 0; k < CPU_MAX; k++)
+        ti->ran_on[k] = false;
+      sema_init (&ti->done, 0);
+
+      snprintf (name, sizeof name, "counter %d", i);
+      thread_create (name, PRI_DEFAULT, counter_thread, ti);
+    }
+
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      sema_down (&info[i].done);
+      total += info[i].increments;
+      for (j = 0; j < CPU_MAX; j++)
+        ran_on[j] |= info[i].ran_on[j];
+    }
+
+  if (counter != total)
+    fail ("counter is %lld after %lld increments", counter, total);
+  msg ("Counter matches the number of increments.");
+
+  for (j = 0; j < CPU_CNT; j++)
+    if (!ran_on[j])
+      fail ("no test thread ran on CPU %d", j);
+  msg ("Every CPU ran test threads.");
+}
+
+static void
+counter_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+
+  while (timer_elapsed (ti->start_time) < SPIN_TICKS) 
+    {
+      enum intr_level old_level = intr_disable ();
+      ti->ran_on[cpu_current ()->id] = true;
+      intr_set_level (old_level);
+
+      lock_acquire (&counter_lock);
+      counter++;
+      lock_release (&counter_lock);
+      ti->increments++;
+    }
+  sema_up (&ti->done);
+}
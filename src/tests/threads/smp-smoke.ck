@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(smp-smoke) begin
+(smp-smoke) 2 CPUs online.
+(smp-smoke) Counter matches the number of increments.
+(smp-smoke) Every CPU ran test threads.
+(smp-smoke) end
+EOF
+pass;
@@ -0,0 +1,84 @@
+/* Checks that the stride scheduler divides the CPU between
+   threads in proportion to their tickets.
+
+   Three threads with 300, 200, and 100 tickets spin for 6
+   seconds, so they should receive 300, 200, and 100 of the 600
+   ticks, respectively.  The stride scheduler is deterministic,
+   so each must come within a few time slices of its share. */
+
+#include <stdio.h>
+#include <inttypes.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define THREAD_CNT 3
+#define SPIN_TICKS (6 * TIMER_FREQ)
+#define TOLERANCE 10
+
+struct thread_info 
+  {
+    int64_t start_time;
+    int tick_count;
+    int tickets;
+  };
+
+static thread_func load_thread;
+
+void
+test_stride_share (void) 
+{
+  static const int tickets[THREAD_CNT] = {300, 200, 100};
+  static const int expected[THREAD_CNT] = {300, 200, 100};
+  struct thread_info info[THREAD_CNT];
+  int64_t start_time;
+  int i;
+
+  ASSERT (thread_stride);
+
+  start_time = timer_ticks ();
+  for (i = 0; i < THREAD_CNT; i++) 
+    {
+      struct thread_info *ti = &info[i];
+      char name[16];
+
+      ti->start_time = start_time;
+      ti->tick_count = 0;
+      ti->tickets = tickets[i];
+
+      snprintf (name, sizeof name, "load %d", i);
+      thread_create (name, PRI_DEFAULT, load_thread, ti);
+    }
+
+  msg ("Sleeping 10 seconds to let threads run, please wait...");
+  timer_sleep (10 * TIMER_FREQ);
+
+  for (i = 0; i < THREAD_CNT; i++)
+    {
+      int diff = info[i].tick_count - expected[i];
+      if (diff < -TOLERANCE || diff > TOLERANCE)
+        fail ("Thread %d (%d tickets) received %d ticks, expected %d.",
+              i, tickets[i], info[i].tick_count, expected[i]);
+      msg ("Thread %d (%d tickets) received its share.", i, tickets[i]);
+    }
+}
+
+static void
+load_thread (void *ti_) 
+{
+  struct thread_info *ti = ti_;
+  int64_t sleep_time = 2 * TIMER_FREQ;
+  int64_t spin_time = sleep_time + SPIN_TICKS;
+  int64_t last_time = 0;
+
+  thread_set_tickets (ti->tickets);
+  timer_sleep (sleep_time - timer_elapsed (ti->start_time));
+  while (timer_elapsed (ti->start_time) < spin_time) 
+    {
+      int64_t cur_time = timer_ticks ();
+      if (cur_time != last_time)
+        ti->tick_count++;
+      last_time = cur_time;
+    }
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(stride-share) begin
+(stride-share) Sleeping 10 seconds to let threads run, please wait...
+(stride-share) Thread 0 (300 tickets) received its share.
+(stride-share) Thread 1 (200 tickets) received its share.
+(stride-share) Thread 2 (100 tickets) received its share.
+(stride-share) end
+EOF
+pass;
@@ -17,6 +17,8 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"timer-events", test_timer_events},
+    {"timer-clock", test_timer_clock},
     {"priority-change", test_priority_change},
     {"priority-donate-one", test_priority_donate_one},
     {"priority-donate-multiple", test_priority_donate_multiple},
@@ -25,10 +27,24 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"sema-pingpong", test_sema_pingpong},
+    {"rwlock-priority", test_rwlock_priority},
+    {"rwlock-readers", test_rwlock_readers},
+    {"waitq-pingpong", test_waitq_pingpong},
     {"priority-fifo", test_priority_fifo},
     {"priority-preempt", test_priority_preempt},
     {"priority-sema", test_priority_sema},
     {"priority-condvar", test_priority_condvar},
+    {"rt-edf", test_rt_edf},
+    {"cfs-fair", test_cfs_fair},
+    {"stride-share", test_stride_share},
+    {"slice-adapt", test_slice_adapt},
+    {"palloc-coalesce", test_palloc_coalesce},
+    {"slab-cache", test_slab_cache},
+    {"malloc-frag", test_malloc_frag},
+    {"palloc-prezero", test_palloc_prezero},
+    {"pse-map", test_pse_map},
+    {"smp-smoke", test_smp_smoke},
     {"mlfqs-load-1", test_mlfqs_load_1},
     {"mlfqs-load-60", test_mlfqs_load_60},
     {"mlfqs-load-avg", test_mlfqs_load_avg},
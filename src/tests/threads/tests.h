@@ -11,6 +11,8 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_timer_events;
+extern test_func test_timer_clock;
 extern test_func test_priority_change;
 extern test_func test_priority_donate_one;
 extern test_func test_priority_donate_multiple;
@@ -19,10 +21,24 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_sema_pingpong;
+extern test_func test_rwlock_priority;
+extern test_func test_rwlock_readers;
+extern test_func test_waitq_pingpong;
 extern test_func test_priority_fifo;
 extern test_func test_priority_preempt;
 extern test_func test_priority_sema;
 extern test_func test_priority_condvar;
+extern test_func test_rt_edf;
+extern test_func test_cfs_fair;
+extern test_func test_stride_share;
+extern test_func test_slice_adapt;
+extern test_func test_palloc_coalesce;
+extern test_func test_slab_cache;
+extern test_func test_malloc_frag;
+extern test_func test_palloc_prezero;
+extern test_func test_pse_map;
+extern test_func test_smp_smoke;
 extern test_func test_mlfqs_load_1;
 extern test_func test_mlfqs_load_60;
 extern test_func test_mlfqs_load_avg;
@@ -0,0 +1,86 @@
+/* Checks the nanosecond clock.
+
+   timer_now_ns() must never run backward, whether read in a
+   tight loop, across a timer tick, or with interrupts off, and
+   must keep pace with the timer tick over a longer sleep.
+   timer_usleep() for less than a tick busy-waits on the same
+   clock, so it must not return early, and must not overshoot by
+   as much as a tick. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "devices/timer.h"
+
+#define NS_PER_TICK (1000 * 1000 * 1000 / TIMER_FREQ)
+
+/* Number of timer_now_ns() readings to compare. */
+#define READ_CNT 100000
+
+/* Length of the sub-tick sleeps to time, in microseconds. */
+static const int64_t usleeps[] = {10, 100, 1000, 5000};
+
+static void check_monotonic (const char *);
+
+void
+test_timer_clock (void) 
+{
+  enum intr_level old_level;
+  int64_t start, start_tick, elapsed, elapsed_ticks;
+  size_t i;
+
+  check_monotonic ("interrupts on");
+  old_level = intr_disable ();
+  check_monotonic ("interrupts off");
+  intr_set_level (old_level);
+
+  /* Over a 20-tick sleep, the clock must agree with the tick
+     count to within a tick. */
+  timer_sleep (1);
+  start = timer_now_ns ();
+  start_tick = timer_ticks ();
+  timer_sleep (20);
+  elapsed = timer_elapsed_ns (start);
+  elapsed_ticks = timer_elapsed (start_tick);
+  if (elapsed < (elapsed_ticks - 1) * NS_PER_TICK
+      || elapsed > (elapsed_ticks + 1) * NS_PER_TICK)
+    fail ("%lld ns elapsed over %lld ticks", elapsed, elapsed_ticks);
+  msg ("clock keeps pace with the timer tick.");
+
+  for (i = 0; i < sizeof usleeps / sizeof *usleeps; i++) 
+    {
+      int64_t us = usleeps[i];
+
+      start = timer_now_ns ();
+      timer_usleep (us);
+      elapsed = timer_elapsed_ns (start);
+      if (elapsed < us * 1000)
+        fail ("timer_usleep (%lld) returned after only %lld ns",
+              us, elapsed);
+      if (elapsed >= us * 1000 + NS_PER_TICK)
+        fail ("timer_usleep (%lld) took %lld ns", us, elapsed);
+      msg ("timer_usleep (%lld) is precise.", us);
+    }
+}
+
+/* Reads the clock READ_CNT times, failing if any reading is
+   less than the one before it.  Spans at least one timer tick
+   when interrupts are on, so that the tick's update of the clock
+   is covered too. */
+static void
+check_monotonic (const char *desc) 
+{
+  int64_t prev = timer_now_ns ();
+  int64_t start_tick = timer_ticks ();
+  int i;
+
+  for (i = 0; i < READ_CNT || (intr_get_level () == INTR_ON
+                               && timer_elapsed (start_tick) < 1); i++) 
+    {
+      int64_t now = timer_now_ns ();
+      if (now < prev)
+        fail ("%s: clock went back %lld ns", desc, prev - now);
+      prev = now;
+    }
+  msg ("%s: clock is monotonic.", desc);
+}
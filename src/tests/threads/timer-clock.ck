@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timer-clock) begin
+(timer-clock) interrupts on: clock is monotonic.
+(timer-clock) interrupts off: clock is monotonic.
+(timer-clock) clock keeps pace with the timer tick.
+(timer-clock) timer_usleep (10) is precise.
+(timer-clock) timer_usleep (100) is precise.
+(timer-clock) timer_usleep (1000) is precise.
+(timer-clock) timer_usleep (5000) is precise.
+(timer-clock) end
+EOF
+pass;
@@ -0,0 +1,148 @@
+/* Checks kernel timer events.
+
+   Arms events that expire after 5, 70, 300, and 5000 ticks.  The
+   first starts out in level 0 of the timing wheel, the next two
+   in level 1, and the last in level 2, so that it has to be
+   cascaded down twice.  Also arms one that is cancelled, one
+   that is re-armed from a later to an earlier time, and one so
+   far off that it is beyond the wheel's reach and must still be
+   pending at the end.  Each must expire exactly on time, and
+   only once.  Finally, a deferred event must run in the worker
+   thread with interrupts on. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/workqueue.h"
+#include "devices/timer.h"
+
+#define EVENT_CNT 6
+#define CANCEL_IDX 4
+#define REARM_IDX 5
+
+/* Beyond the 64**4 ticks that the wheel covers. */
+#define FAR_TICKS (1LL << 25)
+
+struct event_info 
+  {
+    struct timer_event ev;      /* The timer event. */
+    const char *name;           /* Name to print. */
+    int64_t expected;           /* Tick at which it should expire. */
+    int64_t actual;             /* Tick at which it did expire. */
+    int fired;                  /* # of times it expired. */
+  };
+
+static struct semaphore done_sema;
+
+static timer_func expire;
+static timer_func expire_deferred;
+
+void
+test_timer_events (void) 
+{
+  static const char *names[EVENT_CNT] = 
+    {"5 ticks", "70 ticks", "300 ticks", "5000 ticks", "cancelled",
+     "re-armed"};
+  static const int64_t delays[EVENT_CNT] = {5, 70, 300, 5000, 10, 200};
+  struct event_info info[EVENT_CNT];
+  struct event_info far;
+  struct event_info deferred;
+  enum intr_level old_level;
+  int64_t start;
+  int i;
+
+  sema_init (&done_sema, 0);
+
+  /* Arm everything within a single tick. */
+  old_level = intr_disable ();
+  start = timer_ticks ();
+  for (i = 0; i < EVENT_CNT; i++) 
+    {
+      struct event_info *ei = &info[i];
+
+      ei->name = names[i];
+      ei->expected = start + delays[i];
+      ei->fired = 0;
+      timer_event_init (&ei->ev, expire, ei);
+      if (timer_add (&ei->ev, delays[i]))
+        fail ("%s: newly armed event was pending", ei->name);
+    }
+  far.name = "far";
+  far.fired = 0;
+  timer_event_init (&far.ev, expire, &far);
+  timer_add (&far.ev, FAR_TICKS);
+
+  /* Cancel one and re-arm another to expire sooner. */
+  if (!timer_cancel (&info[CANCEL_IDX].ev))
+    fail ("cancelled: event not pending");
+  if (timer_cancel (&info[CANCEL_IDX].ev))
+    fail ("cancelled: event still pending after cancel");
+  if (!timer_add (&info[REARM_IDX].ev, 40))
+    fail ("re-armed: event not pending");
+  info[REARM_IDX].expected = start + 40;
+  intr_set_level (old_level);
+
+  for (i = 0; i < EVENT_CNT - 1; i++)
+    sema_down (&done_sema);
+  timer_sleep (20);
+
+  for (i = 0; i < EVENT_CNT; i++) 
+    {
+      struct event_info *ei = &info[i];
+
+      if (i == CANCEL_IDX) 
+        {
+          if (ei->fired != 0)
+            fail ("%s: expired anyway", ei->name);
+          msg ("%s: did not expire.", ei->name);
+        }
+      else if (ei->fired != 1)
+        fail ("%s: expired %d times", ei->name, ei->fired);
+      else if (ei->actual != ei->expected)
+        fail ("%s: expired at tick %lld instead of %lld", ei->name,
+              ei->actual - start, ei->expected - start);
+      else
+        msg ("%s: expired on time.", ei->name);
+    }
+
+  /* The far event must have survived every cascade so far. */
+  if (far.fired != 0)
+    fail ("far: expired after %lld ticks", far.actual - start);
+  if (!timer_cancel (&far.ev))
+    fail ("far: event not pending");
+  msg ("far: still pending.");
+
+  deferred.name = "deferred";
+  deferred.fired = 0;
+  timer_event_init_deferred (&deferred.ev, expire_deferred, &deferred);
+  timer_add (&deferred.ev, 3);
+  sema_down (&done_sema);
+  msg ("deferred: ran in the worker thread.");
+}
+
+/* Timer function, called in the timer interrupt. */
+static void
+expire (void *ei_) 
+{
+  struct event_info *ei = ei_;
+
+  ASSERT (intr_context ());
+  ei->actual = timer_ticks ();
+  ei->fired++;
+  sema_up (&done_sema);
+}
+
+/* Deferred timer function. */
+static void
+expire_deferred (void *ei_) 
+{
+  struct event_info *ei = ei_;
+
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (workqueue_in_worker ());
+  ei->fired++;
+  sema_up (&done_sema);
+}
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(timer-events) begin
+(timer-events) 5 ticks: expired on time.
+(timer-events) 70 ticks: expired on time.
+(timer-events) 300 ticks: expired on time.
+(timer-events) 5000 ticks: expired on time.
+(timer-events) cancelled: did not expire.
+(timer-events) re-armed: expired on time.
+(timer-events) far: still pending.
+(timer-events) deferred: ran in the worker thread.
+(timer-events) end
+EOF
+pass;
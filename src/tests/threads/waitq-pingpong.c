@@ -0,0 +1,71 @@
+/* Makes control "ping-pong" between a pair of threads through a
+   wait queue and a counter: the main thread waits for the
+   counter to become even, the helper for it to become odd, and
+   each increments it in turn. */
+
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define ROUND_CNT 10
+
+/* Shared between the main thread and the helper. */
+struct waitq_test 
+  {
+    struct wait_queue wq;       /* Queue both threads wait on. */
+    int value;                  /* Incremented by each in turn. */
+  };
+
+static thread_func helper_thread;
+static wait_cond_func is_odd;
+static wait_cond_func is_even;
+
+void
+test_waitq_pingpong (void) 
+{
+  struct waitq_test test;
+  int i;
+
+  waitq_init (&test.wq);
+  test.value = 0;
+  thread_create ("helper", PRI_DEFAULT, helper_thread, &test);
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      waitq_wait (&test.wq, is_even, &test);
+      test.value++;
+      waitq_wake_all (&test.wq);
+    }
+  waitq_wait (&test.wq, is_even, &test);
+  if (test.value != 2 * ROUND_CNT)
+    fail ("counter is %d, not %d", test.value, 2 * ROUND_CNT);
+  msg ("Counter reached %d.", test.value);
+}
+
+static void
+helper_thread (void *test_) 
+{
+  struct waitq_test *test = test_;
+  int i;
+
+  for (i = 0; i < ROUND_CNT; i++) 
+    {
+      waitq_wait (&test->wq, is_odd, test);
+      test->value++;
+      waitq_wake_all (&test->wq);
+    }
+}
+
+static bool
+is_odd (void *test_) 
+{
+  struct waitq_test *test = test_;
+  return test->value % 2 == 1;
+}
+
+static bool
+is_even (void *test_) 
+{
+  struct waitq_test *test = test_;
+  return test->value % 2 == 0;
+}
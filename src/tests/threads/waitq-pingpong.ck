@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(waitq-pingpong) begin
+(waitq-pingpong) Counter reached 20.
+(waitq-pingpong) end
+EOF
+pass;
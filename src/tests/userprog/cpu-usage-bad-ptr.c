@@ -0,0 +1,14 @@
+/* Passes an unmapped pointer to the cpu_usage system call,
+   which must cause the process to be terminated with exit code
+   -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  msg ("cpu_usage(0x20101234): %d",
+       cpu_usage (0, (struct cpu_usage *) 0x20101234));
+}
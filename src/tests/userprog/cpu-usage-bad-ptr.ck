@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(cpu-usage-bad-ptr) begin
+cpu-usage-bad-ptr: exit(-1)
+EOF
+pass;
@@ -0,0 +1,15 @@
+/* Passes a pointer into the process's own code segment, which
+   is mapped read-only, to the cpu_usage system call.  The kernel
+   must not write there, but instead terminate the process with
+   exit code -1. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  msg ("cpu_usage(test_main): %d",
+       cpu_usage (0, (struct cpu_usage *) test_main));
+}
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(cpu-usage-ro) begin
+cpu-usage-ro: exit(-1)
+EOF
+pass;
@@ -0,0 +1,18 @@
+/* Calls the cpu_usage system call for the calling process, with
+   both pid 0 and its own pid, and for a pid that does not
+   exist. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  struct cpu_usage usage;
+
+  CHECK (cpu_usage (0, &usage), "cpu_usage(0)");
+  CHECK (usage.user_ticks >= 0 && usage.kernel_ticks >= 0
+         && usage.wait_ns >= 0, "usage is sane");
+  msg ("cpu_usage(-1): %d", cpu_usage (-1, &usage));
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(cpu-usage) begin
+(cpu-usage) cpu_usage(0)
+(cpu-usage) usage is sane
+(cpu-usage) cpu_usage(-1): 0
+(cpu-usage) end
+cpu-usage: exit(0)
+EOF
+pass;
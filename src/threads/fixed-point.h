@@ -0,0 +1,98 @@
+#ifndef THREADS_FIXED_POINT_H
+#define THREADS_FIXED_POINT_H
+
+#include <stdint.h>
+
+/* Signed 17.14 fixed-point arithmetic, as used by the
+   multi-level feedback queue scheduler.
+
+   A fixed-point number is stored in an ordinary int.  The low
+   FIX_SHIFT bits are the fraction and the remaining bits, less
+   the sign bit, are the integer part, so the largest
+   representable value is about 131,071.999.  See "Fixed-Point
+   Real Arithmetic" in the reference guide for the formulas. */
+typedef int fixed_t;
+
+#define FIX_SHIFT 14                    /* # of fraction bits. */
+#define FIX_ONE (1 << FIX_SHIFT)        /* 1.0 in fixed point. */
+
+/* Returns integer N as a fixed-point number. */
+static inline fixed_t
+fix_int (int n)
+{
+  return n * FIX_ONE;
+}
+
+/* Returns the fixed-point fraction N / D. */
+static inline fixed_t
+fix_frac (int n, int d)
+{
+  return n * FIX_ONE / d;
+}
+
+/* Returns X truncated toward zero to an integer. */
+static inline int
+fix_trunc (fixed_t x)
+{
+  return x / FIX_ONE;
+}
+
+/* Returns X rounded to the nearest integer. */
+static inline int
+fix_round (fixed_t x)
+{
+  return (x >= 0 ? x + FIX_ONE / 2 : x - FIX_ONE / 2) / FIX_ONE;
+}
+
+/* Returns X + Y. */
+static inline fixed_t
+fix_add (fixed_t x, fixed_t y)
+{
+  return x + y;
+}
+
+/* Returns X + N, for integer N. */
+static inline fixed_t
+fix_add_int (fixed_t x, int n)
+{
+  return x + n * FIX_ONE;
+}
+
+/* Returns X - Y. */
+static inline fixed_t
+fix_sub (fixed_t x, fixed_t y)
+{
+  return x - y;
+}
+
+/* Returns X * Y.  The product is formed in 64 bits so that it
+   cannot overflow before it is scaled back down. */
+static inline fixed_t
+fix_mul (fixed_t x, fixed_t y)
+{
+  return (int64_t) x * y / FIX_ONE;
+}
+
+/* Returns X * N, for integer N. */
+static inline fixed_t
+fix_mul_int (fixed_t x, int n)
+{
+  return x * n;
+}
+
+/* Returns X / Y.  The dividend is scaled up in 64 bits so that
+   the quotient keeps its fraction bits. */
+static inline fixed_t
+fix_div (fixed_t x, fixed_t y)
+{
+  return (int64_t) x * FIX_ONE / y;
+}
+
+/* Returns X / N, for integer N. */
+static inline fixed_t
+fix_div_int (fixed_t x, int n)
+{
+  return x / n;
+}
+
+#endif /* threads/fixed-point.h */
@@ -19,10 +19,15 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/sched-trace.h"
+#include "threads/smp.h"
+#include "threads/synch.h"
 #include "threads/thread.h"
+#include "threads/workqueue.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
+#include "userprog/fpu.h"
 #include "userprog/gdt.h"
 #include "userprog/syscall.h"
 #include "userprog/tss.h"
@@ -41,6 +46,10 @@ size_t ram_pages;
 /* Page directory with kernel mappings only. */
 uint32_t *base_page_dir;
 
+/* Support for 4 MB pages: CPUID leaf 1 EDX bit, CR4 bit. */
+#define CPUID_PSE 0x00000008
+#define CR4_PSE 0x00000010
+
 #ifdef FILESYS
 /* -f: Format the file system? */
 static bool format_filesys;
@@ -51,6 +60,7 @@ bool power_off_when_done;
 
 static void ram_init (void);
 static void paging_init (void);
+static bool cpu_has_pse (void);
 
 static char **read_command_line (void);
 static char **parse_options (char **argv);
@@ -79,6 +89,7 @@ main (void)
      then enable console locking. */
   thread_init ();
   console_init ();  
+  workqueue_init ();
 
   /* Greet user. */
   printf ("Pintos booting with %'zu kB RAM...\n", ram_pages * PGSIZE / 1024);
@@ -92,6 +103,7 @@ main (void)
 #ifdef USERPROG
   tss_init ();
   gdt_init ();
+  fpu_init ();
 #endif
 
   /* Initialize interrupt handlers. */
@@ -106,9 +118,13 @@ main (void)
 
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
+  workqueue_start ();
   serial_init_queue ();
   timer_calibrate ();
 
+  /* Start the other CPUs, if any. */
+  smp_init ();
+
 #ifdef FILESYS
   /* Initialize file system. */
   disk_init ();
@@ -148,6 +164,13 @@ ram_init (void)
    new page directory.  Points base_page_dir to the page
    directory it creates.
 
+   If the CPU supports 4 MB pages, each 4 MB of RAM that does not
+   contain kernel text is mapped with a single large page, which
+   takes one TLB entry instead of 1,024.  The 4 MB that contain
+   the kernel text are still mapped with a page table, so that
+   the text alone can be read-only, and so is any partial 4 MB at
+   the end of RAM.
+
    At the time this function is called, the active page table
    (set up by loader.S) only maps the first 4 MB of RAM, so we
    should not try to use extravagant amounts of memory.
@@ -157,6 +180,7 @@ paging_init (void)
 {
   uint32_t *pd, *pt;
   size_t page;
+  bool pse = cpu_has_pse ();
   extern char _start, _end_kernel_text;
 
   pd = base_page_dir = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -169,6 +193,14 @@ paging_init (void)
       size_t pte_idx = pt_no (vaddr);
       bool in_kernel_text = &_start <= vaddr && vaddr < &_end_kernel_text;
 
+      if (pse && pte_idx == 0 && page + PTSPAN / PGSIZE <= ram_pages
+          && (vaddr + PTSPAN <= &_start || &_end_kernel_text <= vaddr)) 
+        {
+          pd[pde_idx] = pde_create_large (vaddr, true);
+          page += PTSPAN / PGSIZE - 1;
+          continue;
+        }
+
       if (pd[pde_idx] == 0)
         {
           pt = palloc_get_page (PAL_ASSERT | PAL_ZERO);
@@ -178,6 +210,16 @@ paging_init (void)
       pt[pte_idx] = pte_create_kernel (vaddr, !in_kernel_text);
     }
 
+  /* Large pages take effect only once CR4.PSE is set.  Setting
+     it does not affect the loader's page table, which has
+     none. */
+  if (pse) 
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | CR4_PSE));
+    }
+
   /* Store the physical address of the page directory into CR3
      aka PDBR (page directory base register).  This activates our
      new page tables immediately.  See [IA32-v2a] "MOV--Move
@@ -186,6 +228,15 @@ paging_init (void)
   asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
 }
 
+/* Returns true if the CPU supports 4 MB pages. */
+static bool
+cpu_has_pse (void) 
+{
+  uint32_t eax = 1, ebx, ecx, edx;
+  asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+  return (edx & CPUID_PSE) != 0;
+}
+
 /* Breaks the kernel command line into words and returns them as
    an argv-like array. */
 static char **
@@ -244,6 +295,22 @@ parse_options (char **argv)
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
         thread_mlfqs = true;
+      else if (!strcmp (name, "-cfs"))
+        thread_cfs = true;
+      else if (!strcmp (name, "-stride"))
+        thread_stride = true;
+      else if (!strcmp (name, "-slice-adapt"))
+        thread_slice_adapt = true;
+      else if (!strcmp (name, "-slice-min"))
+        thread_slice_min = atoi (value);
+      else if (!strcmp (name, "-slice-max"))
+        thread_slice_max = atoi (value);
+      else if (!strcmp (name, "-tickless"))
+        timer_tickless = true;
+      else if (!strcmp (name, "-sched-trace"))
+        sched_trace_enabled = true;
+      else if (!strcmp (name, "-lockstat"))
+        lock_stats_enabled = true;
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
@@ -251,6 +318,12 @@ parse_options (char **argv)
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
     }
+
+  if (thread_mlfqs + thread_cfs + thread_stride > 1)
+    PANIC ("-mlfqs, -cfs, and -stride are mutually exclusive");
+  if (thread_slice_min < 1 || thread_slice_min > thread_slice_max)
+    PANIC ("bad time slice bounds %u...%u", thread_slice_min,
+           thread_slice_max);
   
   return argv;
 }
@@ -270,6 +343,13 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+/* Prints the table of threads. */
+static void
+print_threads (char **argv UNUSED) 
+{
+  thread_print_table ();
+}
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -287,6 +367,7 @@ run_actions (char **argv)
   static const struct action actions[] = 
     {
       {"run", 2, run_task},
+      {"ps", 1, print_threads},
 #ifdef FILESYS
       {"ls", 1, fsutil_ls},
       {"cat", 2, fsutil_cat},
@@ -335,6 +416,7 @@ usage (void)
 #else
           "  run TEST           Run TEST.\n"
 #endif
+          "  ps                 List threads and their CPU usage.\n"
 #ifdef FILESYS
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
@@ -349,6 +431,14 @@ usage (void)
           "  -f                 Format file system disk during startup.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
+          "  -cfs               Use completely fair scheduler.\n"
+          "  -stride            Use stride scheduler.\n"
+          "  -slice-adapt       Adapt time slices to thread behavior.\n"
+          "  -slice-min=TICKS   Set shortest adaptive slice (default: 1).\n"
+          "  -slice-max=TICKS   Set longest adaptive slice (default: 16).\n"
+          "  -tickless          Stop the timer tick while the CPU is idle.\n"
+          "  -sched-trace       Print scheduling decisions at power off.\n"
+          "  -lockstat          Print lock contention statistics at power off.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
 #endif
@@ -387,6 +477,7 @@ print_stats (void)
 {
   timer_print_stats ();
   thread_print_stats ();
+  thread_print_exited ();
 #ifdef FILESYS
   disk_print_stats ();
 #endif
@@ -395,4 +486,7 @@ print_stats (void)
 #ifdef USERPROG
   exception_print_stats ();
 #endif
+  sched_trace_dump ();
+  lock_print_stats ();
+  intr_print_stats ();
 }
@@ -6,6 +6,8 @@
 #include "threads/flags.h"
 #include "threads/intr-stubs.h"
 #include "threads/io.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/timer.h"
@@ -31,14 +33,92 @@ static const char *intr_names[INTR_CNT];
    pre-empted.  Handlers for external interrupts also may not
    sleep, although they may invoke intr_yield_on_return() to
    request that a new process be scheduled just before the
-   interrupt returns. */
-static bool in_external_intr;   /* Are we processing an external interrupt? */
-static bool yield_on_return;    /* Should we yield on interrupt return? */
+   interrupt returns.  This state is per-CPU; see struct cpu. */
+
+/* The interrupt lock.
+
+   On a uniprocessor, turning interrupts off is enough to make a
+   sequence of code atomic, and the device drivers, the timer and
+   the thread bookkeeping outside the run queues depend on that.
+   Once a second CPU is online, that is no longer true, so from
+   then on intr_disable() also acquires this spinlock, and
+   intr_enable() releases it, as does the entry and exit path of
+   every interrupt that arrives through an interrupt gate, so
+   that code that disables interrupts stays correct without
+   change.
+
+   The scheduler and the primitives in synch.h do not use it.
+   They protect their own data with spinlocks of their own: one
+   per run queue, one inside each semaphore, reader-writer lock
+   and wait queue, and donation_lock for priority donation.  They
+   turn interrupts off with intr_disable_local(), which only
+   clears the interrupt flag, so CPUs in the scheduler or in
+   synch.h at the same time run in parallel.  The rules are:
+
+     - A spinlock is only held with interrupts off.
+
+     - A CPU that holds any other spinlock must not call
+       intr_disable(), which could wait for the interrupt lock
+       while its holder waits for that spinlock.  Taking a
+       spinlock while holding the interrupt lock is fine.
+
+   The lock is owned by a CPU, and the thread running there
+   while it is held.  schedule() releases it before switching
+   threads and takes it back for a thread that held it when that
+   thread runs again, so a thread that sleeps with interrupts
+   off, for example in intq_getc(), does not hold it while
+   asleep. */
+static struct spinlock intr_lock;
+static struct cpu *intr_lock_owner; /* CPU holding intr_lock. */
+static bool intr_lock_active;       /* Use intr_lock at all? */
+
+static bool intr_lock_acquire (void);
+static void intr_lock_release (void);
+
+static enum intr_level enable (const void *caller);
+static enum intr_level disable (const void *caller);
+
+#ifdef INTR_LATENCY
+/* Interrupts-off latency tracking, built only with INTR_LATENCY
+   defined.
+
+   Each stretch of time that a CPU runs with interrupts off, from
+   the intr_disable() or interrupt entry that turned them off to
+   the intr_enable() or interrupt return that turned them back
+   on, is timed with the time-stamp counter.  The longest stretch
+   is kept, with the code addresses where it began and ended,
+   along with a histogram of lengths by power of 2 of cycles.
+   The start of the current stretch is kept per-CPU, and the
+   totals are protected by latency_lock, since a CPU need not
+   hold the interrupt lock while its interrupts are off.  Timing
+   starts in intr_init(), before which cpu_current() does not
+   work. */
+#define LATENCY_BUCKETS 64
+static bool latency_active;             /* Timing interrupts-off? */
+static struct spinlock latency_lock;    /* Protects the totals. */
+static unsigned long long latency_cnt;  /* # of stretches timed. */
+static unsigned long long latency_hist[LATENCY_BUCKETS];
+static uint64_t latency_max;            /* Longest, in TSC cycles. */
+static const void *latency_max_start;   /* Where it began. */
+static const void *latency_max_end;     /* Where it ended. */
+
+static void latency_start (const void *caller);
+static void latency_end (const void *caller);
+static inline uint64_t rdtsc (void);
+#else
+#define latency_start(CALLER) ((void) 0)
+#define latency_end(CALLER) ((void) 0)
+#endif
 
 /* Programmable Interrupt Controller helpers. */
 static void pic_init (void);
 static void pic_end_of_interrupt (int irq);
 
+/* True once intr_pic_disable() has handed the ISA interrupts to
+   the I/O APIC, which delivers them to the same vectors but
+   expects an end of interrupt on the local APIC. */
+static bool pic_disabled;
+
 /* Interrupt Descriptor Table helpers. */
 static uint64_t make_intr_gate (void (*) (void), int dpl);
 static uint64_t make_trap_gate (void (*) (void), int dpl);
@@ -67,12 +147,55 @@ intr_get_level (void)
 enum intr_level
 intr_set_level (enum intr_level level) 
 {
-  return level == INTR_ON ? intr_enable () : intr_disable ();
+  const void *caller = __builtin_return_address (0);
+  return level == INTR_ON ? enable (caller) : disable (caller);
 }
 
 /* Enables interrupts and returns the previous interrupt status. */
 enum intr_level
 intr_enable (void) 
+{
+  return enable (__builtin_return_address (0));
+}
+
+/* Disables interrupts and returns the previous interrupt status. */
+enum intr_level
+intr_disable (void) 
+{
+  return disable (__builtin_return_address (0));
+}
+
+/* Disables interrupts on the running CPU only, without taking
+   the interrupt lock, and returns the previous interrupt status.
+   For code that protects its data with spinlocks of its own. */
+enum intr_level
+intr_disable_local (void) 
+{
+  enum intr_level old_level = intr_get_level ();
+
+  asm volatile ("cli" : : : "memory");
+  if (old_level == INTR_ON)
+    latency_start (__builtin_return_address (0));
+
+  return old_level;
+}
+
+/* Restores the interrupt status LEVEL returned by
+   intr_disable_local().  If LEVEL is INTR_OFF, does nothing:
+   interrupts stay off, and if the interrupt lock is held, it
+   stays held. */
+void
+intr_set_level_local (enum intr_level level) 
+{
+  if (level == INTR_ON)
+    enable (__builtin_return_address (0));
+}
+
+/* Enables interrupts for intr_enable() or intr_set_level(),
+   called from CALLER, and returns the previous interrupt
+   status. */
+static enum intr_level
+enable (const void *caller UNUSED) 
 {
   enum intr_level old_level = intr_get_level ();
   ASSERT (!intr_context ());
@@ -81,14 +204,19 @@ intr_enable (void)
 
      See [IA32-v2b] "STI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
+  if (old_level == INTR_OFF)
+    latency_end (caller);
+  intr_lock_release ();
   asm volatile ("sti");
 
   return old_level;
 }
 
-/* Disables interrupts and returns the previous interrupt status. */
-enum intr_level
-intr_disable (void) 
+/* Disables interrupts for intr_disable() or intr_set_level(),
+   called from CALLER, and returns the previous interrupt
+   status. */
+static enum intr_level
+disable (const void *caller UNUSED) 
 {
   enum intr_level old_level = intr_get_level ();
 
@@ -96,15 +224,112 @@ intr_disable (void)
      See [IA32-v2b] "CLI" and [IA32-v3a] 5.8.1 "Masking Maskable
      Hardware Interrupts". */
   asm volatile ("cli" : : : "memory");
+  intr_lock_acquire ();
+  if (old_level == INTR_ON)
+    latency_start (caller);
 
   return old_level;
 }
+
+/* Re-enables interrupts and waits for the next one, for use by
+   an idle thread.  Interrupts must be off.
+
+   The `sti' instruction disables interrupts until the completion
+   of the next instruction, so `sti; hlt' executes atomically:
+   no interrupt can be handled between re-enabling interrupts and
+   waiting for the next one to occur, which would waste as much
+   as one clock tick worth of time.  See [IA32-v2a] "HLT",
+   [IA32-v2b] "STI", and [IA32-v3a] 7.11.1 "HLT Instruction". */
+void
+intr_enable_and_wait (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!intr_context ());
+
+  latency_end (__builtin_return_address (0));
+  intr_lock_release ();
+  asm volatile ("sti; hlt" : : : "memory");
+}
+
+/* Starts using the interrupt lock.  Must be called, with
+   interrupts on, before a second CPU comes online. */
+void
+intr_lock_start (void) 
+{
+  ASSERT (intr_get_level () == INTR_ON);
+
+  /* With interrupts off, take the lock by hand, so that the
+     invariant holds from the moment the lock is in use. */
+  asm volatile ("cli" : : : "memory");
+  spinlock_init (&intr_lock);
+  intr_lock_active = true;
+  intr_lock_acquire ();
+  intr_enable ();
+}
+
+/* Releases the interrupt lock if the running CPU holds it, and
+   returns true if it did, so that the caller can take it back
+   later with intr_lock_retake().  Interrupts must be off.  Used
+   by schedule(), so that the lock does not pass to the thread
+   switched to. */
+bool
+intr_lock_drop (void) 
+{
+  bool held;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  held = intr_lock_active && intr_lock_owner == cpu_current ();
+  if (held)
+    intr_lock_release ();
+  return held;
+}
+
+/* Takes back the interrupt lock after intr_lock_drop().
+   Interrupts must be off. */
+void
+intr_lock_retake (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  intr_lock_acquire ();
+}
+
+/* Acquires the interrupt lock for the running CPU, if it does
+   not already hold it, and returns true if it had to.
+   Interrupts must be off. */
+static bool
+intr_lock_acquire (void) 
+{
+  if (intr_lock_active) 
+    {
+      struct cpu *c = cpu_current ();
+      if (intr_lock_owner != c) 
+        {
+          spinlock_acquire (&intr_lock);
+          intr_lock_owner = c;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Releases the interrupt lock if the running CPU holds it.
+   Interrupts must be off. */
+static void
+intr_lock_release (void) 
+{
+  if (intr_lock_active && intr_lock_owner == cpu_current ()) 
+    {
+      intr_lock_owner = NULL;
+      spinlock_release (&intr_lock);
+    }
+}
 
 /* Initializes the interrupt system. */
 void
 intr_init (void)
 {
-  uint64_t idtr_operand;
   int i;
 
   /* Initialize interrupt controller. */
@@ -114,11 +339,8 @@ intr_init (void)
   for (i = 0; i < INTR_CNT; i++)
     idt[i] = make_intr_gate (intr_stubs[i], 0);
 
-  /* Load IDT register.
-     See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
-     Descriptor Table (IDT)". */
-  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
-  asm volatile ("lidt %0" : : "m" (idtr_operand));
+  /* Load IDT register. */
+  intr_init_ap ();
 
   /* Initialize intr_names. */
   for (i = 0; i < INTR_CNT; i++)
@@ -142,6 +364,30 @@ intr_init (void)
   intr_names[17] = "#AC Alignment Check Exception";
   intr_names[18] = "#MC Machine-Check Exception";
   intr_names[19] = "#XF SIMD Floating-Point Exception";
+
+#ifdef INTR_LATENCY
+  latency_active = true;
+#endif
+}
+
+/* Loads the IDT into the running CPU's IDT register.  Called by
+   intr_init() on the bootstrap processor and by each
+   application processor as it starts, with interrupts off.  On
+   an application processor, also takes the interrupt lock,
+   since interrupts are off.
+
+   See [IA32-v2a] "LIDT" and [IA32-v3a] 5.10 "Interrupt
+   Descriptor Table (IDT)". */
+void
+intr_init_ap (void) 
+{
+  uint64_t idtr_operand;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  idtr_operand = make_idtr_operand (sizeof idt - 1, idt);
+  asm volatile ("lidt %0" : : "m" (idtr_operand));
+  intr_lock_acquire ();
 }
 
 /* Registers interrupt VEC_NO to invoke HANDLER with descriptor
@@ -161,6 +407,14 @@ register_handler (uint8_t vec_no, int dpl, enum intr_level level,
   intr_names[vec_no] = name;
 }
 
+/* Returns true if VEC_NO is an external interrupt, that is, one
+   from the PIC or from a local APIC. */
+static bool
+is_external (uint8_t vec_no) 
+{
+  return (vec_no >= 0x20 && vec_no <= 0x2f) || vec_no >= LAPIC_VEC_RESCHED;
+}
+
 /* Registers external interrupt VEC_NO to invoke HANDLER, which
    is named NAME for debugging purposes.  The handler will
    execute with interrupts disabled. */
@@ -168,7 +422,7 @@ void
 intr_register_ext (uint8_t vec_no, intr_handler_func *handler,
                    const char *name) 
 {
-  ASSERT (vec_no >= 0x20 && vec_no <= 0x2f);
+  ASSERT (is_external (vec_no));
   register_handler (vec_no, 0, INTR_OFF, handler, name);
 }
 
@@ -189,7 +443,7 @@ void
 intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
                    intr_handler_func *handler, const char *name)
 {
-  ASSERT (vec_no < 0x20 || vec_no > 0x2f);
+  ASSERT (!is_external (vec_no));
   register_handler (vec_no, dpl, level, handler, name);
 }
 
@@ -198,7 +452,7 @@ intr_register_int (uint8_t vec_no, int dpl, enum intr_level level,
 bool
 intr_context (void) 
 {
-  return in_external_intr;
+  return cpu_current ()->in_external_intr;
 }
 
 /* During processing of an external interrupt, directs the
@@ -209,7 +463,7 @@ void
 intr_yield_on_return (void) 
 {
   ASSERT (intr_context ());
-  yield_on_return = true;
+  cpu_current ()->yield_on_return = true;
 }
 
 /* 8259A Programmable Interrupt Controller. */
@@ -252,6 +506,21 @@ pic_init (void)
   outb (0xa1, 0x00);
 }
 
+/* Masks every interrupt on both PICs, for smp_init(), which
+   routes the ISA interrupts through the I/O APIC instead.  They
+   keep their vectors 0x20...0x2f, but from now on
+   intr_handler() acknowledges them on the local APIC.
+   Interrupts must be off. */
+void
+intr_pic_disable (void) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  outb (0x21, 0xff);
+  outb (0xa1, 0xff);
+  pic_disabled = true;
+}
+
 /* Sends an end-of-interrupt signal to the PIC for the given IRQ.
    If we don't acknowledge the IRQ, it will never be delivered to
    us again, so this is important.  */
@@ -338,28 +607,48 @@ make_idtr_operand (uint16_t limit, void *base)
 void
 intr_handler (struct intr_frame *frame) 
 {
+  struct cpu *c;
   bool external;
+  bool took_lock = false;
   intr_handler_func *handler;
 
+  /* An interrupt gate turned interrupts off, so take the
+     interrupt lock to match, unless the interrupted code already
+     held it.  Code that had interrupts off without the lock, by
+     intr_disable_local(), can only be interrupted by an
+     exception. */
+  if (intr_get_level () == INTR_OFF) 
+    {
+      took_lock = intr_lock_acquire ();
+      if (frame->eflags & FLAG_IF)
+        latency_start (intr_handlers[frame->vec_no]);
+    }
+  c = cpu_current ();
+
   /* External interrupts are special.
      We only handle one at a time (so interrupts must be off)
-     and they need to be acknowledged on the PIC (see below).
-     An external interrupt handler cannot sleep. */
-  external = frame->vec_no >= 0x20 && frame->vec_no < 0x30;
+     and they need to be acknowledged on the PIC or local APIC
+     (see below).  An external interrupt handler cannot sleep. */
+  external = is_external (frame->vec_no);
   if (external) 
     {
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (!intr_context ());
 
-      in_external_intr = true;
-      yield_on_return = false;
+      c->in_external_intr = true;
+      c->yield_on_return = false;
+
+      /* Restart the periodic tick if the idle thread stopped it,
+         so that handlers see an up-to-date tick count. */
+      timer_idle_exit ();
     }
 
   /* Invoke the interrupt's handler. */
   handler = intr_handlers[frame->vec_no];
   if (handler != NULL)
     handler (frame);
-  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f)
+  else if (frame->vec_no == 0x27 || frame->vec_no == 0x2f
+           || frame->vec_no == LAPIC_VEC_SPURIOUS)
     {
       /* There is no handler, but this interrupt can trigger
          spuriously due to a hardware fault or hardware race
@@ -379,12 +668,25 @@ intr_handler (struct intr_frame *frame)
       ASSERT (intr_get_level () == INTR_OFF);
       ASSERT (intr_context ());
 
-      in_external_intr = false;
-      pic_end_of_interrupt (frame->vec_no); 
+      c->in_external_intr = false;
+      if (frame->vec_no < 0x30 && !pic_disabled)
+        pic_end_of_interrupt (frame->vec_no); 
+      else if (frame->vec_no != LAPIC_VEC_SPURIOUS)
+        lapic_eoi ();
 
-      if (yield_on_return) 
-        thread_yield (); 
+      /* The yield may resume us on a different CPU. */
+      if (c->yield_on_return) 
+        thread_preempt (); 
     }
+
+  /* Give back the interrupt lock if we took it.  The handler
+     may have released it itself, by turning interrupts on, and a
+     yield above took it back for us if it was held.  Interrupts
+     come back on with `iret' if they were on before. */
+  if ((frame->eflags & FLAG_IF) && intr_get_level () == INTR_OFF)
+    latency_end (intr_handlers[frame->vec_no]);
+  if (took_lock)
+    intr_lock_release ();
 }
 
 /* Dumps interrupt frame F to the console, for debugging. */
@@ -411,6 +713,98 @@ intr_dump_frame (const struct intr_frame *f)
           f->cs, f->ds, f->es, f->ss);
 }
 
+/* Prints interrupts-off latency statistics, if the kernel was
+   built with INTR_LATENCY defined.  Code addresses can be turned
+   into function names with the "backtrace" utility. */
+void
+intr_print_stats (void) 
+{
+#ifdef INTR_LATENCY
+  int i;
+
+  /* Stop timing, so that printing does not disturb the
+     statistics being printed. */
+  latency_active = false;
+
+  printf ("Interrupts off: %llu times, longest %lld ns, from %p to %p\n",
+          latency_cnt, timer_tsc_to_ns (latency_max),
+          latency_max_start, latency_max_end);
+  for (i = 0; i < LATENCY_BUCKETS; i++)
+    if (latency_hist[i] > 0)
+      printf ("  %'12lld ns or longer: %llu\n",
+              timer_tsc_to_ns ((uint64_t) 1 << i), latency_hist[i]);
+#endif
+}
+
+#ifdef INTR_LATENCY
+/* Notes that interrupts just went off on the running CPU, turned
+   off by the code at CALLER.  Interrupts must be off. */
+static void
+latency_start (const void *caller) 
+{
+  struct cpu *c;
+
+  if (!latency_active)
+    return;
+  c = cpu_current ();
+  c->intr_off_tsc = rdtsc ();
+  c->intr_off_caller = caller;
+}
+
+/* Notes that the code at CALLER is about to turn interrupts back
+   on, on the running CPU, and records how long they were off.
+   Interrupts must be off. */
+static void
+latency_end (const void *caller) 
+{
+  struct cpu *c;
+  uint64_t cycles;
+  uint32_t hi, lo;
+  int bucket;
+
+  if (!latency_active)
+    return;
+  c = cpu_current ();
+  if (c->intr_off_tsc == 0)
+    {
+      /* Interrupts went off before timing started, or without
+         going through intr_disable(). */
+      return;
+    }
+  cycles = rdtsc () - c->intr_off_tsc;
+  c->intr_off_tsc = 0;
+
+  /* Find floor(log2(cycles)) a 32-bit half at a time, so that
+     __builtin_clz() needs no help from libgcc. */
+  hi = cycles >> 32;
+  lo = cycles;
+  bucket = (hi != 0 ? 63 - __builtin_clz (hi)
+            : lo != 0 ? 31 - __builtin_clz (lo)
+            : 0);
+
+  spinlock_acquire (&latency_lock);
+  latency_cnt++;
+  latency_hist[bucket]++;
+  if (cycles > latency_max) 
+    {
+      latency_max = cycles;
+      latency_max_start = c->intr_off_caller;
+      latency_max_end = caller;
+    }
+  spinlock_release (&latency_lock);
+}
+
+/* Returns the CPU's time-stamp counter.  See [IA32-v2b]
+   "RDTSC". */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+#endif /* INTR_LATENCY */
+
 /* Returns the name of interrupt VEC. */
 const char *
 intr_name (uint8_t vec) 
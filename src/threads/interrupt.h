@@ -15,6 +15,12 @@ enum intr_level intr_get_level (void);
 enum intr_level intr_set_level (enum intr_level);
 enum intr_level intr_enable (void);
 enum intr_level intr_disable (void);
+enum intr_level intr_disable_local (void);
+void intr_set_level_local (enum intr_level);
+void intr_enable_and_wait (void);
+void intr_lock_start (void);
+bool intr_lock_drop (void);
+void intr_lock_retake (void);
 
 /* Interrupt stack frame. */
 struct intr_frame
@@ -58,6 +64,8 @@ struct intr_frame
 typedef void intr_handler_func (struct intr_frame *);
 
 void intr_init (void);
+void intr_init_ap (void);
+void intr_pic_disable (void);
 void intr_register_ext (uint8_t vec, intr_handler_func *, const char *name);
 void intr_register_int (uint8_t vec, int dpl, enum intr_level,
                         intr_handler_func *, const char *name);
@@ -65,6 +73,7 @@ bool intr_context (void);
 void intr_yield_on_return (void);
 
 void intr_dump_frame (const struct intr_frame *);
+void intr_print_stats (void);
 const char *intr_name (uint8_t vec);
 
 #endif /* threads/interrupt.h */
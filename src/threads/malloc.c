@@ -11,11 +11,11 @@
 
 /* A simple implementation of malloc().
 
-   The size of each request, in bytes, is rounded up to a power
-   of 2 and assigned to the "descriptor" that manages blocks of
-   that size.  The descriptor keeps a list of free blocks.  If
-   the free list is nonempty, one of its blocks is used to
-   satisfy the request.
+   The size of each request, in bytes, is rounded up to the
+   nearest of a fixed set of "size classes" and assigned to the
+   "descriptor" that manages blocks of that size.  The descriptor
+   keeps a list of free blocks.  If the free list is nonempty,
+   one of its blocks is used to satisfy the request.
 
    Otherwise, a new page of memory, called an "arena", is
    obtained from the page allocator (if none is available,
@@ -28,11 +28,27 @@
    blocks, we remove all of the arena's blocks from the free list
    and give the arena back to the page allocator.
 
-   We can't handle blocks bigger than 2 kB using this scheme,
-   because they're too big to fit in a single page with a
-   descriptor.  We handle those by allocating contiguous pages
-   with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   Between 32 and 448 bytes, the size classes are at most 25%
+   apart, so rounding wastes less than a fifth of a block, where
+   rounding up to a power of 2 would waste up to half.  Below 32
+   bytes, the 8-byte granularity makes the steps coarser: a
+   17-byte request takes a 24-byte block, wasting 29%.  From 448
+   up, each class's size is as large as it can be without
+   fitting fewer blocks into an arena, so that the space at the
+   end of an arena goes to the blocks instead.  These classes
+   are spaced by the number of blocks per page, not by size, so
+   they grow further apart: three 1360-byte or two 2040-byte
+   blocks fit in a page, a 50% step, so a 1361-byte request
+   wastes a third of its block.  Still, a 1.1 kB request, say,
+   takes a third of a page instead of a whole one.
+
+   There are no classes between 2040 bytes and a page.  A page
+   holds only one such block along with its arena header, so
+   such a class would use a whole page per block, just like the
+   path for big blocks: we handle blocks bigger than 2040 bytes
+   by allocating contiguous pages with the page allocator and
+   sticking the allocation size at the beginning of the
+   allocated block's arena header. */
 
 /* Descriptor. */
 struct desc
@@ -60,9 +76,27 @@ struct block
     struct list_elem free_elem; /* Free list element. */
   };
 
+/* Block sizes of the size classes, in bytes.  Each is a
+   multiple of 8, and each from 448 up is the largest multiple of
+   8 for which a page holds as many blocks as it does. */
+static const unsigned short class_sizes[] =
+  {
+      16,   24,   32,   40,   48,   56,   64,   80,   96,  112,
+     128,  160,  192,  224,  256,  288,  320,  384,  448,  576,
+     680,  816, 1016, 1360, 2040,
+  };
+#define DESC_CNT (sizeof class_sizes / sizeof *class_sizes)
+
+/* Largest request served by a descriptor. */
+#define MAX_DESC_SIZE 2040
+
 /* Our set of descriptors. */
-static struct desc descs[10];   /* Descriptors. */
-static size_t desc_cnt;         /* Number of descriptors. */
+static struct desc descs[DESC_CNT];
+
+/* Maps a request of SIZE bytes, 1 <= SIZE <= MAX_DESC_SIZE, to
+   the index in descs[] of the smallest descriptor that can
+   satisfy it, as size_to_desc[(SIZE - 1) / 8]. */
+static uint8_t size_to_desc[MAX_DESC_SIZE / 8];
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
@@ -71,17 +105,23 @@ static struct block *arena_to_block (struct arena *, size_t idx);
 void
 malloc_init (void) 
 {
-  size_t block_size;
+  size_t i, j;
 
-  for (block_size = 16; block_size < PGSIZE / 2; block_size *= 2)
+  for (i = j = 0; i < DESC_CNT; i++)
     {
-      struct desc *d = &descs[desc_cnt++];
-      ASSERT (desc_cnt <= sizeof descs / sizeof *descs);
-      d->block_size = block_size;
-      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / block_size;
+      struct desc *d = &descs[i];
+      d->block_size = class_sizes[i];
+      d->blocks_per_arena = (PGSIZE - sizeof (struct arena)) / d->block_size;
+      ASSERT (d->block_size % 8 == 0);
+      ASSERT (i == 0 || d->block_size > descs[i - 1].block_size);
+      ASSERT (d->blocks_per_arena >= 2);
       list_init (&d->free_list);
       lock_init (&d->lock);
+
+      for (; j < d->block_size / 8; j++)
+        size_to_desc[j] = i;
     }
+  ASSERT (descs[DESC_CNT - 1].block_size == MAX_DESC_SIZE);
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
@@ -99,10 +139,7 @@ malloc (size_t size)
 
   /* Find the smallest descriptor that satisfies a SIZE-byte
      request. */
-  for (d = descs; d < descs + desc_cnt; d++)
-    if (d->block_size >= size)
-      break;
-  if (d == descs + desc_cnt) 
+  if (size > MAX_DESC_SIZE) 
     {
       /* SIZE is too big for any descriptor.
          Allocate enough pages to hold SIZE plus an arena. */
@@ -118,6 +155,8 @@ malloc (size_t size)
       a->free_cnt = page_cnt;
       return a + 1;
     }
+  d = &descs[size_to_desc[(size - 1) / 8]];
+  ASSERT (d->block_size >= size);
 
   lock_acquire (&d->lock);
 
@@ -2,13 +2,16 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/spinlock.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 
@@ -24,14 +27,48 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
+
+   Each pool is managed by a binary buddy allocator.  The free
+   pages are grouped into blocks of 2**K pages, for "order" K,
+   each aligned on a multiple of its size within the pool, and
+   kept on one free list per order, linked through the first
+   bytes of each free block.  An allocation of N pages takes a
+   block of the smallest order that holds N pages, splitting a
+   larger block in halves if need be, and gives back the pages
+   beyond the first N.  A freed block is merged with its "buddy",
+   the other half of the block of the next order up, as long as
+   the buddy is free too.  Both take O(lg n) time in the size of
+   the pool, instead of a scan of the whole pool.
+
+   Each pool also keeps a small reserve of single pages that are
+   already zeroed, which palloc_get_page(PAL_ZERO) hands out
+   without having to zero a page itself.  The idle thread refills
+   the reserve, up to a high watermark, by calling
+   palloc_zero_idle() when there is nothing else to run.  Pages
+   in the reserve count as in use, but an allocation that would
+   otherwise fail gives the reserve back to the free lists and
+   tries again, so the reserve never makes memory run out
+   sooner. */
+#define ORDER_CNT 24                    /* Up to 2**23 pages (32 GB). */
+#define ZEROED_MAX 64                   /* Largest reserve of zeroed pages. */
 
 /* A memory pool. */
 struct pool
   {
     struct lock lock;                   /* Mutual exclusion. */
+    struct spinlock spin;               /* Protects the members below. */
     struct bitmap *used_map;            /* Bitmap of free pages. */
     uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    struct list free_lists[ORDER_CNT];  /* Free blocks, by order. */
+    uint8_t *free_order;                /* For each page, 1 + order of
+                                           the free block it begins,
+                                           or 0 if none. */
+    struct list zeroed;                 /* Pages already zeroed. */
+    size_t zeroed_cnt;                  /* Zeroed pages, plus any
+                                           being zeroed. */
+    size_t zeroed_max;                  /* High watermark for zeroed. */
   };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -43,6 +80,13 @@ size_t user_page_limit = SIZE_MAX;
 static void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
 static bool page_from_pool (const struct pool *, void *page);
+static size_t alloc_pages (struct pool *, size_t page_cnt);
+static void free_pages (struct pool *, size_t page_idx, size_t page_cnt);
+static void free_block (struct pool *, size_t page_idx, int order);
+static int order_for (size_t page_cnt);
+static void *get_zeroed (struct pool *);
+static void release_zeroed (struct pool *);
+static bool zero_page (struct pool *);
 
 /* Initializes the page allocator. */
 void
@@ -78,24 +122,43 @@ void *
 palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
 {
   struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
-  void *pages;
+  enum intr_level old_level;
+  void *pages = NULL;
+  bool zeroed = false;
   size_t page_idx;
 
   if (page_cnt == 0)
     return NULL;
 
+  /* See palloc_free_multiple() for why the spinlock. */
   lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+  old_level = intr_disable_local ();
+  spinlock_acquire (&pool->spin);
+  if ((flags & PAL_ZERO) && page_cnt == 1)
+    pages = get_zeroed (pool);
+  if (pages != NULL)
+    zeroed = true;
+  else 
+    {
+      page_idx = alloc_pages (pool, page_cnt);
+      if (page_idx == BITMAP_ERROR && pool->zeroed_cnt > 0) 
+        {
+          release_zeroed (pool);
+          page_idx = alloc_pages (pool, page_cnt);
+        }
+      if (page_idx != BITMAP_ERROR)
+        pages = pool->base + PGSIZE * page_idx;
+    }
+  spinlock_release (&pool->spin);
+  intr_set_level_local (old_level);
   lock_release (&pool->lock);
 
-  if (page_idx != BITMAP_ERROR)
-    pages = pool->base + PGSIZE * page_idx;
-  else
-    pages = NULL;
-
   if (pages != NULL) 
     {
-      if (flags & PAL_ZERO)
+      /* A zeroed page's list_elem is all that needs clearing. */
+      if (zeroed)
+        memset (pages, 0, sizeof (struct list_elem));
+      else if (flags & PAL_ZERO)
         memset (pages, 0, PGSIZE * page_cnt);
     }
   else 
@@ -125,6 +188,7 @@ void
 palloc_free_multiple (void *pages, size_t page_cnt) 
 {
   struct pool *pool;
+  enum intr_level old_level;
   size_t page_idx;
 
   ASSERT (pg_ofs (pages) == 0);
@@ -144,8 +208,18 @@ palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
+  /* schedule_tail() frees a dying thread's page with interrupts
+     off, so it cannot take the pool lock.  Instead, every change
+     to the bitmap and the free lists is made with interrupts off
+     and the pool's spinlock held.  It is not the interrupt lock,
+     which schedule_tail() must not take (see interrupt.c). */
+  old_level = intr_disable_local ();
+  spinlock_acquire (&pool->spin);
   ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
   bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  free_pages (pool, page_idx, page_cnt);
+  spinlock_release (&pool->spin);
+  intr_set_level_local (old_level);
 }
 
 /* Frees the page at PAGE. */
@@ -155,15 +229,30 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Zeroes a free page and adds it to the reserve of zeroed pages
+   in the first pool whose reserve is below its high watermark.
+   Returns true if successful, false if every reserve is full or
+   its pool has no free pages.  Called by the idle thread, with
+   interrupts on. */
+bool
+palloc_zero_idle (void) 
+{
+  ASSERT (intr_get_level () == INTR_ON);
+  return zero_page (&kernel_pool) || zero_page (&user_pool);
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
 init_pool (struct pool *p, void *base, size_t page_cnt, const char *name) 
 {
-  /* We'll put the pool's used_map at its base.
-     Calculate the space needed for the bitmap
-     and subtract it from the pool's size. */
-  size_t bm_pages = DIV_ROUND_UP (bitmap_buf_size (page_cnt), PGSIZE);
+  /* We'll put the pool's used_map at its base, followed by
+     free_order.  Calculate the space needed for them and
+     subtract it from the pool's size. */
+  size_t bm_size = bitmap_buf_size (page_cnt);
+  size_t bm_pages = DIV_ROUND_UP (bm_size + page_cnt, PGSIZE);
+  int order;
+
   if (bm_pages > page_cnt)
     PANIC ("Not enough memory in %s for bitmap.", name);
   page_cnt -= bm_pages;
@@ -172,8 +261,192 @@ init_pool (struct pool *p, void *base, size_t page_cnt, const char *name)
 
   /* Initialize the pool. */
   lock_init (&p->lock);
-  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_pages * PGSIZE);
+  spinlock_init (&p->spin);
+  p->used_map = bitmap_create_in_buf (page_cnt, base, bm_size);
   p->base = base + bm_pages * PGSIZE;
+  p->page_cnt = page_cnt;
+  for (order = 0; order < ORDER_CNT; order++)
+    list_init (&p->free_lists[order]);
+  p->free_order = (uint8_t *) base + bm_size;
+  memset (p->free_order, 0, page_cnt);
+  list_init (&p->zeroed);
+  p->zeroed_cnt = 0;
+  p->zeroed_max = page_cnt / 16 < ZEROED_MAX ? page_cnt / 16 : ZEROED_MAX;
+
+  /* Hand out every page to the free lists. */
+  free_pages (p, 0, page_cnt);
+}
+
+/* Allocates PAGE_CNT contiguous pages from POOL and returns the
+   index of the first one, or BITMAP_ERROR if there is no free
+   block big enough.  POOL's spinlock must be held. */
+static size_t
+alloc_pages (struct pool *pool, size_t page_cnt) 
+{
+  int order = order_for (page_cnt);
+  int o;
+  size_t page_idx;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Find the smallest free block that is big enough. */
+  for (o = order; o < ORDER_CNT; o++)
+    if (!list_empty (&pool->free_lists[o]))
+      break;
+  if (o >= ORDER_CNT)
+    return BITMAP_ERROR;
+  page_idx = pg_no (list_pop_front (&pool->free_lists[o]))
+             - pg_no (pool->base);
+  pool->free_order[page_idx] = 0;
+
+  /* Split it down to the right order, freeing the upper halves,
+     then give back the pages beyond PAGE_CNT. */
+  while (o > order) 
+    {
+      o--;
+      free_block (pool, page_idx + ((size_t) 1 << o), o);
+    }
+  free_pages (pool, page_idx + page_cnt, ((size_t) 1 << order) - page_cnt);
+
+  ASSERT (!bitmap_any (pool->used_map, page_idx, page_cnt));
+  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, true);
+  return page_idx;
+}
+
+/* Returns the PAGE_CNT pages in POOL starting at PAGE_IDX to the
+   free lists, as the fewest aligned blocks that cover them.
+   POOL's spinlock must be held. */
+static void
+free_pages (struct pool *pool, size_t page_idx, size_t page_cnt) 
+{
+  while (page_cnt > 0) 
+    {
+      /* Largest order at which PAGE_IDX is aligned and that fits
+         in PAGE_CNT. */
+      int order = 0;
+      while (order + 1 < ORDER_CNT
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+
+      free_block (pool, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Adds the block of 2**ORDER pages in POOL at PAGE_IDX to the
+   free lists, first merging it with its buddy, and the result
+   with its own buddy, and so on, as long as the buddy is free.
+   POOL's spinlock must be held. */
+static void
+free_block (struct pool *pool, size_t page_idx, int order) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (order + 1 < ORDER_CNT) 
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx >= pool->page_cnt
+          || pool->free_order[buddy_idx] != order + 1)
+        break;
+
+      list_remove ((struct list_elem *) (pool->base + PGSIZE * buddy_idx));
+      pool->free_order[buddy_idx] = 0;
+      if (buddy_idx < page_idx)
+        page_idx = buddy_idx;
+      order++;
+    }
+
+  pool->free_order[page_idx] = order + 1;
+  list_push_front (&pool->free_lists[order],
+                   (struct list_elem *) (pool->base + PGSIZE * page_idx));
+}
+
+/* Removes and returns a page from POOL's reserve of zeroed
+   pages, or a null pointer if the reserve is empty.  The page is
+   zero except for its first sizeof (struct list_elem) bytes.
+   POOL's spinlock must be held. */
+static void *
+get_zeroed (struct pool *pool) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (list_empty (&pool->zeroed))
+    return NULL;
+  pool->zeroed_cnt--;
+  return list_pop_front (&pool->zeroed);
+}
+
+/* Returns every page in POOL's reserve of zeroed pages to the
+   free lists.  POOL's spinlock must be held. */
+static void
+release_zeroed (struct pool *pool) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  while (!list_empty (&pool->zeroed)) 
+    {
+      void *page = list_pop_front (&pool->zeroed);
+      size_t page_idx = pg_no (page) - pg_no (pool->base);
+
+      pool->zeroed_cnt--;
+      bitmap_reset (pool->used_map, page_idx);
+      free_pages (pool, page_idx, 1);
+    }
+}
+
+/* If POOL's reserve of zeroed pages is below its high watermark,
+   takes a free page from POOL, zeroes it, and adds it to the
+   reserve.  Returns true if successful, false if the reserve is
+   full or POOL has no free pages.  Interrupts must be on. */
+static bool
+zero_page (struct pool *pool) 
+{
+  enum intr_level old_level;
+  size_t page_idx;
+  void *page;
+
+  /* Take a page, counting it in the reserve right away so that
+     the idle threads on other CPUs do not overfill it. */
+  old_level = intr_disable_local ();
+  spinlock_acquire (&pool->spin);
+  if (pool->zeroed_cnt >= pool->zeroed_max) 
+    {
+      spinlock_release (&pool->spin);
+      intr_set_level_local (old_level);
+      return false;
+    }
+  page_idx = alloc_pages (pool, 1);
+  if (page_idx != BITMAP_ERROR)
+    pool->zeroed_cnt++;
+  spinlock_release (&pool->spin);
+  intr_set_level_local (old_level);
+  if (page_idx == BITMAP_ERROR)
+    return false;
+
+  /* Zero it with interrupts on, then add it to the reserve. */
+  page = pool->base + PGSIZE * page_idx;
+  memset (page, 0, PGSIZE);
+  old_level = intr_disable_local ();
+  spinlock_acquire (&pool->spin);
+  list_push_back (&pool->zeroed, page);
+  spinlock_release (&pool->spin);
+  intr_set_level_local (old_level);
+  return true;
+}
+
+/* Returns the smallest order of block that holds PAGE_CNT
+   pages. */
+static int
+order_for (size_t page_cnt) 
+{
+  int order = 0;
+
+  ASSERT (page_cnt > 0);
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
 }
 
 /* Returns true if PAGE was allocated from POOL,
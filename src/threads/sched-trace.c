@@ -0,0 +1,99 @@
+#include "threads/sched-trace.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
+#include "threads/thread.h"
+
+/* Scheduler trace.
+
+   When enabled, schedule() records each of its decisions in a
+   fixed-size ring buffer: which thread gave up the CPU and why,
+   which thread it picked, on which CPU, and when, as read from
+   the CPU's time-stamp counter.  The newest SCHED_TRACE_CNT
+   events are printed at power off.  Recording an event costs an
+   RDTSC, a few stores and an uncontended spinlock, on top of
+   the interrupts that schedule() already has off. */
+
+/* -sched-trace: Record scheduling decisions? */
+bool sched_trace_enabled;
+
+/* A scheduling decision. */
+struct sched_event
+  {
+    uint64_t tsc;               /* Time-stamp counter. */
+    tid_t prev;                 /* Thread that gave up the CPU. */
+    tid_t next;                 /* Thread chosen to run next. */
+    uint8_t reason;             /* Why PREV gave up the CPU. */
+    uint8_t cpu;                /* CPU that made the decision. */
+  };
+
+/* Ring buffer of the newest events.  Must be a power of 2. */
+#define SCHED_TRACE_CNT 1024
+static struct sched_event events[SCHED_TRACE_CNT];
+static uint64_t event_cnt;      /* # of events ever recorded. */
+static struct spinlock events_lock; /* Protects the two above. */
+
+/* Returns the CPU's time-stamp counter.  See [IA32-v2b]
+   "RDTSC". */
+static inline uint64_t
+rdtsc (void) 
+{
+  uint64_t tsc;
+  asm volatile ("rdtsc" : "=A" (tsc));
+  return tsc;
+}
+
+/* Records that PREV gave up the CPU for REASON and that the
+   scheduler chose NEXT to run.  Interrupts must be off.  Every
+   CPU's scheduler records here, each with its own run queue
+   locked, so the buffer has a spinlock of its own. */
+void
+sched_trace_record (enum sched_reason reason, struct thread *prev,
+                    struct thread *next) 
+{
+  struct sched_event *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!sched_trace_enabled)
+    return;
+
+  spinlock_acquire (&events_lock);
+  e = &events[event_cnt++ % SCHED_TRACE_CNT];
+  e->tsc = rdtsc ();
+  e->prev = prev->tid;
+  e->next = next->tid;
+  e->reason = reason;
+  e->cpu = cpu_current ()->id;
+  spinlock_release (&events_lock);
+}
+
+/* Prints the recorded events, oldest first, with times in TSC
+   cycles since the oldest one. */
+void
+sched_trace_dump (void) 
+{
+  static const char *reasons[] = { "yield", "preempt", "block", "exit" };
+  uint64_t first, i;
+
+  if (!sched_trace_enabled)
+    return;
+
+  /* Stop recording, so that the switches caused by printing do
+     not overwrite the events being printed. */
+  sched_trace_enabled = false;
+
+  first = event_cnt > SCHED_TRACE_CNT ? event_cnt - SCHED_TRACE_CNT : 0;
+  printf ("Schedule trace: %llu events, last %llu shown\n",
+          event_cnt, event_cnt - first);
+  for (i = first; i < event_cnt; i++) 
+    {
+      const struct sched_event *e = &events[i % SCHED_TRACE_CNT];
+      printf ("%14llu cpu%d %-7s %5d -> %d\n",
+              e->tsc - events[first % SCHED_TRACE_CNT].tsc, e->cpu,
+              reasons[e->reason], e->prev, e->next);
+    }
+}
@@ -0,0 +1,24 @@
+#ifndef THREADS_SCHED_TRACE_H
+#define THREADS_SCHED_TRACE_H
+
+#include <stdbool.h>
+
+struct thread;
+
+/* Why the scheduler ran. */
+enum sched_reason
+  {
+    SCHED_YIELD,                /* Running thread yielded. */
+    SCHED_PREEMPT,              /* Running thread was preempted. */
+    SCHED_BLOCK,                /* Running thread blocked. */
+    SCHED_EXIT                  /* Running thread exited. */
+  };
+
+/* -sched-trace: Record scheduling decisions? */
+extern bool sched_trace_enabled;
+
+void sched_trace_record (enum sched_reason, struct thread *prev,
+                         struct thread *next);
+void sched_trace_dump (void);
+
+#endif /* threads/sched-trace.h */
@@ -0,0 +1,286 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* A slab allocator, after Bonwick, "The Slab Allocator: An
+   Object-Caching Kernel Memory Allocator", USENIX 1994.
+
+   Each slab is one page.  The page begins with a struct slab,
+   followed by an array that links the slab's free objects by
+   index, followed by the objects themselves.  Keeping the links
+   out of the objects means that a free object keeps whatever
+   state its constructor gave it.
+
+   A cache keeps its slabs on three lists: those with some free
+   objects and some in use ("partial"), those with no free
+   objects ("full"), and those with no objects in use ("empty").
+   Allocation prefers a partial slab, so that objects stay packed
+   into as few pages as possible.  One empty slab is kept around,
+   so that a loop that allocates and frees a single object does
+   not allocate and free a page each time; any more are returned
+   to the page allocator.
+
+   Usually a few bytes at the end of a slab are left over.  With
+   KMEM_COLOR, successive slabs put their first object at
+   successive multiples of the alignment within those bytes, so
+   that objects at the same index in different slabs do not all
+   fall into the same cache sets. */
+
+/* A cache. */
+struct kmem_cache
+  {
+    char name[16];              /* Name, for debugging. */
+    size_t size;                /* Object size, rounded up to ALIGN. */
+    size_t align;               /* Object alignment. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t objs_ofs;            /* Offset of first object in a slab. */
+    size_t color_cnt;           /* Number of different colors. */
+    size_t color_next;          /* Color of the next slab. */
+    struct list partial;        /* Slabs with some objects free. */
+    struct list full;           /* Slabs with no objects free. */
+    struct list empty;          /* Slabs with all objects free. */
+    struct lock lock;           /* Protects the slab lists. */
+  };
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* End of a slab's free list. */
+#define SLAB_END UINT16_MAX
+
+/* A slab, at the beginning of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    uint8_t *objs;              /* First object. */
+    size_t in_use;              /* Number of objects in use. */
+    uint16_t free_idx;          /* First free object, or SLAB_END. */
+    uint16_t next_free[];       /* Next free object after each one. */
+  };
+
+static struct slab *slab_create (struct kmem_cache *);
+static void slab_move (struct slab *, struct list *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+
+/* Creates and returns a new cache named NAME for objects of SIZE
+   bytes aligned on ALIGN bytes, which must be a power of 2, or 0
+   for pointer alignment.  CTOR, if nonnull, constructs each
+   object.  Returns a null pointer if memory is not available.
+
+   Objects must be small enough that at least one fits in a
+   page along with the slab's bookkeeping. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, size_t align,
+                   kmem_ctor_func *ctor, enum kmem_flags flags) 
+{
+  struct kmem_cache *c;
+  size_t n;
+
+  if (align == 0)
+    align = sizeof (void *);
+  ASSERT (size > 0);
+  ASSERT ((align & (align - 1)) == 0 && align <= PGSIZE);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  strlcpy (c->name, name, sizeof c->name);
+  c->size = ROUND_UP (size, align);
+  c->align = align;
+  c->ctor = ctor;
+
+  /* Fit as many objects as we can into a page, along with the
+     slab header and one free-list link per object. */
+  for (n = PGSIZE / c->size; n > 0; n--) 
+    {
+      c->objs_ofs = ROUND_UP (sizeof (struct slab)
+                              + n * sizeof (uint16_t), align);
+      if (c->objs_ofs + n * c->size <= PGSIZE)
+        break;
+    }
+  ASSERT (n > 0 && n < SLAB_END);
+  c->objs_per_slab = n;
+
+  c->color_cnt = 1;
+  if (flags & KMEM_COLOR)
+    c->color_cnt += (PGSIZE - c->objs_ofs - n * c->size) / align;
+  c->color_next = 0;
+
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  lock_init (&c->lock);
+  return c;
+}
+
+/* Destroys cache C, returning all of its slabs to the page
+   allocator.  No object from C may be in use. */
+void
+kmem_cache_destroy (struct kmem_cache *c) 
+{
+  if (c == NULL)
+    return;
+
+  ASSERT (list_empty (&c->partial));
+  ASSERT (list_empty (&c->full));
+  while (!list_empty (&c->empty)) 
+    {
+      struct list_elem *e = list_pop_front (&c->empty);
+      palloc_free_page (list_entry (e, struct slab, elem));
+    }
+  free (c);
+}
+
+/* Obtains and returns a new object from cache C, or a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c) 
+{
+  struct slab *s;
+  size_t idx;
+
+  lock_acquire (&c->lock);
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else if (!list_empty (&c->empty))
+    s = list_entry (list_front (&c->empty), struct slab, elem);
+  else 
+    {
+      s = slab_create (c);
+      if (s == NULL) 
+        {
+          lock_release (&c->lock);
+          return NULL;
+        }
+    }
+
+  idx = s->free_idx;
+  ASSERT (idx != SLAB_END);
+  s->free_idx = s->next_free[idx];
+  if (++s->in_use == c->objs_per_slab)
+    slab_move (s, &c->full);
+  else if (s->in_use == 1)
+    slab_move (s, &c->partial);
+  lock_release (&c->lock);
+
+  return s->objs + idx * c->size;
+}
+
+/* Returns OBJ, which must have been obtained from cache C, to
+   C. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - s->objs) / c->size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     that would undo its constructor. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->size);
+#endif
+
+  lock_acquire (&c->lock);
+  ASSERT (s->in_use > 0);
+  s->next_free[idx] = s->free_idx;
+  s->free_idx = idx;
+  if (--s->in_use == 0) 
+    {
+      if (list_empty (&c->empty))
+        slab_move (s, &c->empty);
+      else 
+        {
+          list_remove (&s->elem);
+          palloc_free_page (s);
+        }
+    }
+  else if (s->in_use == c->objs_per_slab - 1)
+    slab_move (s, &c->partial);
+  lock_release (&c->lock);
+}
+
+/* Returns the number of objects in each of C's slabs. */
+size_t
+kmem_cache_objs_per_slab (const struct kmem_cache *c) 
+{
+  return c->objs_per_slab;
+}
+
+/* Allocates a new slab for cache C, constructs its objects, and
+   adds it to C's empty list.  Returns the new slab, or a null
+   pointer if memory is not available.  C's lock must be held. */
+static struct slab *
+slab_create (struct kmem_cache *c) 
+{
+  struct slab *s;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&c->lock));
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->objs = (uint8_t *) s + c->objs_ofs + c->color_next * c->align;
+  s->in_use = 0;
+  c->color_next = (c->color_next + 1) % c->color_cnt;
+
+  s->free_idx = 0;
+  for (i = 0; i < c->objs_per_slab; i++) 
+    {
+      s->next_free[i] = i + 1 < c->objs_per_slab ? i + 1 : SLAB_END;
+      if (c->ctor != NULL)
+        c->ctor (s->objs + i * c->size);
+    }
+
+  list_push_front (&c->empty, &s->elem);
+  return s;
+}
+
+/* Moves slab S from whichever of its cache's lists it is on to
+   LIST. */
+static void
+slab_move (struct slab *s, struct list *list) 
+{
+  list_remove (&s->elem);
+  list_push_front (list, &s->elem);
+}
+
+/* Returns the slab that contains OBJ, which must be an object
+   of cache C. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj) 
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid and belongs to C. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that OBJ is an object boundary. */
+  ASSERT ((uint8_t *) obj >= s->objs);
+  ASSERT (((uint8_t *) obj - s->objs) % c->size == 0);
+  ASSERT (((uint8_t *) obj - s->objs) / c->size < c->objs_per_slab);
+
+  return s;
+}
@@ -0,0 +1,37 @@
+#ifndef THREADS_SLAB_H
+#define THREADS_SLAB_H
+
+#include <stddef.h>
+
+/* Object caches.
+
+   A cache hands out objects of a single size, carved out of
+   page-sized "slabs".  Objects are packed at their own size,
+   rounded up only to their alignment, instead of to the next
+   power of 2 as malloc() does, and allocating or freeing one
+   takes constant time.
+
+   If the cache has a constructor, it is called on each object
+   once, when its slab is created, not on every allocation.  An
+   object must be returned to kmem_cache_free() in its
+   constructed state, so that the next kmem_cache_alloc() can
+   hand it out as is. */
+
+/* Called to construct OBJ. */
+typedef void kmem_ctor_func (void *obj);
+
+/* How to create a cache. */
+enum kmem_flags
+  {
+    KMEM_COLOR = 001            /* Stagger objects between slabs. */
+  };
+
+struct kmem_cache *kmem_cache_create (const char *name, size_t size,
+                                      size_t align, kmem_ctor_func *,
+                                      enum kmem_flags);
+void kmem_cache_destroy (struct kmem_cache *);
+void *kmem_cache_alloc (struct kmem_cache *);
+void kmem_cache_free (struct kmem_cache *, void *);
+size_t kmem_cache_objs_per_slab (const struct kmem_cache *);
+
+#endif /* threads/slab.h */
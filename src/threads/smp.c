@@ -0,0 +1,734 @@
+#include "threads/smp.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/init.h"
+#include "threads/interrupt.h"
+#include "threads/io.h"
+#include "threads/palloc.h"
+#include "threads/pte.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+#ifdef USERPROG
+#include "userprog/fpu.h"
+#include "userprog/gdt.h"
+#include "userprog/tss.h"
+#endif
+
+/* Symmetric multiprocessing.
+
+   At boot, only the bootstrap processor (BSP) runs.  smp_init()
+   finds the other processors in the MP configuration table
+   provided by the BIOS and starts each of them by sending it
+   INIT and STARTUP interprocessor interrupts (IPIs) through the
+   local APIC.  An application processor (AP) starts in real mode
+   in a copy of ap-start.S, which switches it to protected mode
+   with paging and calls ap_main().  See [MP-1.4] and [IA32-v3a]
+   chapter 8 "Advanced Programmable Interrupt Controller (APIC)".
+
+   Once the APs are online, the 8259A PIC is masked and the ISA
+   interrupts are routed through the I/O APICs instead, as the MP
+   table's interrupt assignment entries describe (see
+   ioapic_route_isa()).  The timer interrupt, which drives the
+   global tick count, stays on the BSP; the other device
+   interrupts are spread over all the CPUs.  Each AP also sees
+   its own local APIC timer and the reschedule IPI.
+
+   Follow-up work, not yet done: tickless idle with more than
+   one CPU (see timer_idle_enter()).
+
+   tests/threads/smp-smoke, which runs under QEMU with two CPUs,
+   checks that the APs come online and run threads. */
+
+/* Per-CPU data.  cpus[0] is the BSP, cpus[1...cpu_cnt - 1] are
+   the APs that are online. */
+struct cpu cpus[CPU_MAX];
+int cpu_cnt = 1;
+
+/* MP floating pointer structure.  See [MP-1.4] 4.1. */
+struct mp_fps
+  {
+    char signature[4];          /* "_MP_". */
+    uint32_t config_paddr;      /* Physical address of config table. */
+    uint8_t length;             /* Length in 16-byte units. */
+    uint8_t spec_rev;           /* MP specification revision. */
+    uint8_t checksum;           /* All bytes must sum to 0. */
+    uint8_t type;               /* Default configuration type, or 0. */
+    uint8_t features[4];        /* Feature bytes. */
+  };
+
+/* MP configuration table header.  See [MP-1.4] 4.2. */
+struct mp_config
+  {
+    char signature[4];          /* "PCMP". */
+    uint16_t length;            /* Length of base table, in bytes. */
+    uint8_t spec_rev;           /* MP specification revision. */
+    uint8_t checksum;           /* All bytes must sum to 0. */
+    char oem_id[8];             /* System manufacturer. */
+    char product_id[12];        /* Product family. */
+    uint32_t oem_table;         /* Physical address of OEM table. */
+    uint16_t oem_table_size;    /* Size of OEM table. */
+    uint16_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t lapic_paddr;       /* Physical address of local APICs. */
+    uint16_t ext_length;        /* Length of extended entries. */
+    uint8_t ext_checksum;       /* Checksum of extended entries. */
+    uint8_t reserved;
+  };
+
+/* MP configuration table processor entry.  See [MP-1.4]
+   4.3.1.  Other entries are 8 bytes long. */
+struct mp_proc
+  {
+    uint8_t type;               /* MP_PROC. */
+    uint8_t lapic_id;           /* Local APIC ID. */
+    uint8_t lapic_version;      /* Local APIC version. */
+    uint8_t flags;              /* MP_PROC_* flags. */
+    uint32_t signature;         /* CPU signature. */
+    uint32_t features;          /* CPU feature flags. */
+    uint32_t reserved[2];
+  };
+
+/* MP configuration table bus entry.  See [MP-1.4] 4.3.2. */
+struct mp_bus
+  {
+    uint8_t type;               /* MP_BUS. */
+    uint8_t bus_id;             /* Bus ID. */
+    char bus_type[6];           /* "ISA   ", "PCI   ", ... */
+  };
+
+/* MP configuration table I/O APIC entry.  See [MP-1.4]
+   4.3.3. */
+struct mp_ioapic
+  {
+    uint8_t type;               /* MP_IOAPIC. */
+    uint8_t ioapic_id;          /* I/O APIC ID. */
+    uint8_t ioapic_version;     /* I/O APIC version. */
+    uint8_t flags;              /* MP_IOAPIC_ENABLED. */
+    uint32_t paddr;             /* Physical address of registers. */
+  };
+
+/* MP configuration table I/O interrupt assignment entry.  See
+   [MP-1.4] 4.3.4. */
+struct mp_intr
+  {
+    uint8_t type;               /* MP_INTR. */
+    uint8_t intr_type;          /* MP_INTR_INT, ... */
+    uint16_t flags;             /* MP_INTR_* polarity and trigger. */
+    uint8_t src_bus;            /* Source bus ID. */
+    uint8_t src_irq;            /* IRQ on the source bus. */
+    uint8_t dst_ioapic;         /* Destination I/O APIC ID. */
+    uint8_t dst_intin;          /* Destination I/O APIC input. */
+  };
+
+/* MP configuration table entry types. */
+#define MP_PROC 0               /* Processor. */
+#define MP_BUS 1                /* Bus. */
+#define MP_IOAPIC 2             /* I/O APIC. */
+#define MP_INTR 3               /* I/O interrupt assignment. */
+
+/* struct mp_proc flags. */
+#define MP_PROC_ENABLED 0x01    /* Processor is usable. */
+#define MP_PROC_BSP 0x02        /* Processor is the BSP. */
+
+/* struct mp_ioapic flags. */
+#define MP_IOAPIC_ENABLED 0x01  /* I/O APIC is usable. */
+
+/* struct mp_intr interrupt type and flags. */
+#define MP_INTR_INT 0           /* Vectored interrupt. */
+#define MP_INTR_POLARITY 0x0003 /* Polarity field. */
+#define MP_INTR_ACTIVE_LOW 0x0003 /* Active low. */
+#define MP_INTR_TRIGGER 0x000c  /* Trigger mode field. */
+#define MP_INTR_LEVEL 0x000c    /* Level triggered. */
+
+/* struct mp_fps features[1] bit: the system starts in PIC mode,
+   with an IMCR to leave it.  See [MP-1.4] 3.6.2.1. */
+#define MP_FEATURE_IMCR 0x80
+
+/* Local APIC registers, as byte offsets. */
+#define LAPIC_ID 0x020          /* ID. */
+#define LAPIC_TPR 0x080         /* Task priority. */
+#define LAPIC_EOI 0x0b0         /* End of interrupt. */
+#define LAPIC_SVR 0x0f0         /* Spurious interrupt vector. */
+#define LAPIC_ICR_LO 0x300      /* Interrupt command, bits 0...31. */
+#define LAPIC_ICR_HI 0x310      /* Interrupt command, bits 32...63. */
+#define LAPIC_TIMER 0x320       /* Timer local vector table entry. */
+#define LAPIC_LINT0 0x350       /* LINT0 local vector table entry. */
+#define LAPIC_LINT1 0x360       /* LINT1 local vector table entry. */
+#define LAPIC_TICR 0x380        /* Timer initial count. */
+#define LAPIC_TCCR 0x390        /* Timer current count. */
+#define LAPIC_TDCR 0x3e0        /* Timer divide configuration. */
+
+/* Local APIC register bits. */
+#define LAPIC_SVR_ENABLE 0x00000100     /* APIC software enable. */
+#define LAPIC_ICR_INIT 0x00000500       /* INIT delivery mode. */
+#define LAPIC_ICR_STARTUP 0x00000600    /* STARTUP delivery mode. */
+#define LAPIC_ICR_PENDING 0x00001000    /* Delivery status: pending. */
+#define LAPIC_ICR_ASSERT 0x00004000     /* Level: assert. */
+#define LAPIC_ICR_LEVEL 0x00008000      /* Trigger mode: level. */
+#define LAPIC_LVT_MASKED 0x00010000     /* Interrupt masked. */
+#define LAPIC_TIMER_PERIODIC 0x00020000 /* Periodic timer mode. */
+#define LAPIC_TDCR_16 0x3               /* Divide timer clock by 16. */
+
+/* I/O APIC registers, as indexes written to IOREGSEL. */
+#define IOAPIC_VER 0x01         /* Version and max redirection entry. */
+#define IOAPIC_REDTBL 0x10      /* Redirection table, 2 per entry. */
+
+/* I/O APIC redirection entry bits, low word. */
+#define IOAPIC_ACTIVE_LOW 0x00002000    /* Polarity: active low. */
+#define IOAPIC_LEVEL 0x00008000         /* Trigger mode: level. */
+#define IOAPIC_MASKED 0x00010000        /* Interrupt masked. */
+
+/* Maximum number of I/O APICs that we will program. */
+#define IOAPIC_MAX 4
+
+/* Number of ticks over which to calibrate the local APIC timer. */
+#define CALIBRATE_TICKS 10
+
+/* Local APIC registers, mapped at the same virtual address as
+   their physical address.  Each CPU sees its own local APIC. */
+static volatile uint32_t *lapic;
+
+/* An I/O APIC. */
+struct ioapic
+  {
+    uint8_t id;                 /* I/O APIC ID. */
+    volatile uint32_t *regs;    /* IOREGSEL at regs[0], IOWIN at regs[4]. */
+    int entry_cnt;              /* Number of redirection entries. */
+  };
+
+/* Where an ISA IRQ arrives, according to the MP table. */
+struct isa_route
+  {
+    struct ioapic *ioapic;      /* I/O APIC, or null if unknown. */
+    int intin;                  /* Input on that I/O APIC. */
+    uint16_t flags;             /* MP_INTR_* polarity and trigger. */
+  };
+
+/* Local APIC timer count per timer tick.
+   Initialized by lapic_calibrate(). */
+static uint32_t lapic_timer_count;
+
+/* ap-start.S. */
+extern const char ap_start[], ap_start_end[];
+extern const char ap_start_cr3[], ap_start_cr4[], ap_start_esp[];
+
+void ap_main (void) NO_RETURN;
+
+static struct mp_config *mp_find_config (struct mp_fps **);
+static struct mp_fps *mp_search (uintptr_t paddr, size_t size);
+static bool checksum_ok (const void *, size_t size);
+static void *map_mmio (uintptr_t paddr);
+static uint32_t *make_start_page_dir (void);
+static bool start_ap (struct cpu *);
+static uint32_t lapic_read (int reg);
+static void lapic_write (int reg, uint32_t value);
+static void lapic_init (void);
+static void lapic_calibrate (void);
+static void lapic_ipi (uint8_t lapic_id, uint32_t icr);
+static int ioapic_route_isa (struct mp_config *, bool imcr);
+static uint32_t ioapic_read (struct ioapic *, int reg);
+static void ioapic_write (struct ioapic *, int reg, uint32_t value);
+static intr_handler_func resched_interrupt;
+static intr_handler_func lapic_timer_interrupt;
+
+/* Starts all the application processors that the MP
+   configuration table lists, up to CPU_MAX CPUs in all.  Does
+   nothing on a uniprocessor.  Must be called on the BSP with
+   interrupts on, after the timer is calibrated. */
+void
+smp_init (void)
+{
+  struct mp_fps *fps;
+  struct mp_config *mpc;
+  uint8_t ap_ids[CPU_MAX - 1];
+  int ap_cnt, routed_cnt;
+  uint32_t *start_pd;
+  uint32_t cr4;
+  uint8_t *p;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_ON);
+  ASSERT (cpu_cnt == 1);
+
+  mpc = mp_find_config (&fps);
+  if (mpc == NULL)
+    return;
+
+  /* Find the usable processors other than ourselves. */
+  ap_cnt = 0;
+  p = (uint8_t *) (mpc + 1);
+  for (i = 0; i < mpc->entry_cnt; i++)
+    if (*p == MP_PROC)
+      {
+        struct mp_proc *proc = (struct mp_proc *) p;
+        if ((proc->flags & MP_PROC_ENABLED) && !(proc->flags & MP_PROC_BSP)
+            && ap_cnt < CPU_MAX - 1)
+          ap_ids[ap_cnt++] = proc->lapic_id;
+        p += sizeof *proc;
+      }
+    else
+      p += 8;
+  if (ap_cnt == 0)
+    return;
+
+  /* Set up our own local APIC. */
+  lapic = map_mmio (mpc->lapic_paddr);
+  lapic_init ();
+  cpus[0].lapic_id = lapic_read (LAPIC_ID) >> 24;
+  lapic_calibrate ();
+  intr_register_ext (LAPIC_VEC_RESCHED, resched_interrupt, "LAPIC resched");
+  intr_register_ext (LAPIC_VEC_TIMER, lapic_timer_interrupt, "LAPIC timer");
+
+  /* From here on, disabling interrupts is not enough. */
+  intr_lock_start ();
+
+  /* Start the APs one at a time. */
+  start_pd = make_start_page_dir ();
+  memcpy (ptov (AP_START_PADDR), ap_start, ap_start_end - ap_start);
+  *(uint32_t *) ptov (AP_START_PADDR + (ap_start_cr3 - ap_start))
+    = vtop (start_pd);
+  asm ("movl %%cr4, %0" : "=r" (cr4));
+  *(uint32_t *) ptov (AP_START_PADDR + (ap_start_cr4 - ap_start)) = cr4;
+  for (i = 0; i < ap_cnt; i++)
+    {
+      struct cpu *c = &cpus[cpu_cnt];
+      c->lapic_id = ap_ids[i];
+      if (!start_ap (c))
+        {
+          printf ("smp: CPU %d (local APIC %d) did not start\n",
+                  c->id, c->lapic_id);
+          break;
+        }
+    }
+
+  /* Take the device interrupts away from the PIC. */
+  routed_cnt = ioapic_route_isa (mpc, fps->features[1] & MP_FEATURE_IMCR);
+  printf ("smp: %d CPUs online, %d ISA interrupts routed through "
+          "I/O APICs\n", cpu_cnt, routed_cnt);
+}
+
+/* Asks CPU C to reschedule, by sending it an IPI. */
+void
+smp_send_resched (struct cpu *c)
+{
+  lapic_ipi (c->lapic_id, LAPIC_ICR_ASSERT | LAPIC_VEC_RESCHED);
+}
+
+/* Signals the end of an interrupt to the local APIC. */
+void
+lapic_eoi (void)
+{
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Called by ap-start.S, on the idle thread's stack that
+   smp_init() prepared, with interrupts off. */
+void
+ap_main (void)
+{
+  struct cpu *c = cpu_current ();
+
+  /* Switch to the kernel's own page directory, which lacks the
+     identity map of low memory that ap-start.S needed. */
+  asm volatile ("movl %0, %%cr3" : : "r" (vtop (base_page_dir)));
+
+  intr_init_ap ();
+  lapic_init ();
+  lapic_write (LAPIC_TDCR, LAPIC_TDCR_16);
+  lapic_write (LAPIC_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_VEC_TIMER);
+  lapic_write (LAPIC_TICR, lapic_timer_count);
+#ifdef USERPROG
+  tss_init ();
+  gdt_init ();
+  fpu_init ();
+#endif
+
+  /* Come online. */
+  cpu_cnt = c->id + 1;
+  c->started = true;
+  thread_start_ap ();
+}
+
+/* Finds the MP configuration table and returns it, or a null
+   pointer if there is none.  If successful, also stores the MP
+   floating pointer structure into *FPSP.  See [MP-1.4] 4 "MP
+   Configuration Table". */
+static struct mp_config *
+mp_find_config (struct mp_fps **fpsp)
+{
+  uint16_t ebda_seg = *(uint16_t *) ptov (0x40e);
+  uint16_t base_kb = *(uint16_t *) ptov (0x413);
+  struct mp_fps *fps = NULL;
+  struct mp_config *mpc;
+
+  /* Look in the first kB of the extended BIOS data area, in the
+     last kB of base memory, and in the BIOS ROM. */
+  if (ebda_seg != 0)
+    fps = mp_search (ebda_seg << 4, 1024);
+  if (fps == NULL)
+    fps = mp_search (base_kb * 1024 - 1024, 1024);
+  if (fps == NULL)
+    fps = mp_search (0xf0000, 0x10000);
+
+  /* We don't support the default configurations, which have no
+     table. */
+  if (fps == NULL || fps->config_paddr == 0
+      || fps->config_paddr + sizeof *mpc > ram_pages * PGSIZE)
+    return NULL;
+
+  mpc = ptov (fps->config_paddr);
+  if (memcmp (mpc->signature, "PCMP", 4)
+      || fps->config_paddr + mpc->length > ram_pages * PGSIZE
+      || !checksum_ok (mpc, mpc->length))
+    return NULL;
+  *fpsp = fps;
+  return mpc;
+}
+
+/* Searches the SIZE bytes at physical address PADDR for an MP
+   floating pointer structure, which is 16-byte aligned. */
+static struct mp_fps *
+mp_search (uintptr_t paddr, size_t size)
+{
+  uint8_t *p = ptov (paddr);
+  uint8_t *end = p + size;
+
+  for (; p + sizeof (struct mp_fps) <= end; p += 16)
+    if (!memcmp (p, "_MP_", 4) && checksum_ok (p, sizeof (struct mp_fps)))
+      return (struct mp_fps *) p;
+  return NULL;
+}
+
+/* Returns true if the SIZE bytes at P sum to 0, modulo 256. */
+static bool
+checksum_ok (const void *p_, size_t size)
+{
+  const uint8_t *p = p_;
+  uint8_t sum = 0;
+
+  while (size-- > 0)
+    sum += *p++;
+  return sum == 0;
+}
+
+/* Maps the page containing physical address PADDR, which is
+   device memory above the kernel's mapping of RAM, at the same
+   virtual address in the base page directory, with caching
+   disabled.  Returns PADDR as a virtual address.
+
+   This must happen before any process page directory is created,
+   because pagedir_create() copies the base page directory. */
+static void *
+map_mmio (uintptr_t paddr)
+{
+  void *vaddr = (void *) paddr;
+  uint32_t *pde = &base_page_dir[pd_no (vaddr)];
+  uint32_t *pt;
+
+  ASSERT (is_kernel_vaddr (vaddr));
+  ASSERT (paddr - LOADER_PHYS_BASE >= ram_pages * PGSIZE);
+
+  if (*pde == 0)
+    *pde = pde_create (palloc_get_page (PAL_ASSERT | PAL_ZERO));
+  pt = pde_get_pt (*pde);
+  pt[pt_no (vaddr)] = ((paddr & PTE_ADDR)
+                       | PTE_P | PTE_W | PTE_PCD | PTE_PWT);
+  asm volatile ("invlpg (%0)" : : "r" (vaddr) : "memory");
+
+  return vaddr;
+}
+
+/* Returns a page directory for ap-start.S: the base page
+   directory, plus an identity map of the first 4 MB of physical
+   memory, which shares the page table of the kernel's mapping of
+   the same memory. */
+static uint32_t *
+make_start_page_dir (void)
+{
+  uint32_t *pd = palloc_get_page (PAL_ASSERT);
+
+  memcpy (pd, base_page_dir, PGSIZE);
+  pd[0] = base_page_dir[pd_no (PHYS_BASE)];
+  return pd;
+}
+
+/* Starts application processor C and waits up to a second for it
+   to come online.  Returns true if successful, false on
+   timeout.  See [MP-1.4] B.4 "Application Processor Startup". */
+static bool
+start_ap (struct cpu *c)
+{
+  struct thread *idle = thread_prepare_ap (c);
+  uint16_t *warm_reset_vector = ptov (0x467);
+  int64_t start;
+  int i;
+
+  *(uint32_t *) ptov (AP_START_PADDR + (ap_start_esp - ap_start))
+    = (uint32_t) ((uint8_t *) idle + PGSIZE);
+
+  /* Older processors start at the BIOS warm reset vector on
+     INIT, if the CMOS shutdown code says so. */
+  outb (0x70, 0x0f);
+  outb (0x71, 0x0a);
+  warm_reset_vector[0] = 0;
+  warm_reset_vector[1] = AP_START_PADDR >> 4;
+
+  /* INIT, then STARTUP twice. */
+  lapic_ipi (c->lapic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL
+             | LAPIC_ICR_ASSERT);
+  timer_usleep (200);
+  lapic_ipi (c->lapic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+  timer_msleep (10);
+  for (i = 0; i < 2; i++)
+    {
+      lapic_ipi (c->lapic_id, LAPIC_ICR_STARTUP | (AP_START_PADDR >> 12));
+      timer_usleep (200);
+    }
+
+  start = timer_ticks ();
+  while (!c->started && timer_elapsed (start) < TIMER_FREQ)
+    barrier ();
+  return c->started;
+}
+
+/* Returns the value of local APIC register REG. */
+static uint32_t
+lapic_read (int reg)
+{
+  return lapic[reg / sizeof *lapic];
+}
+
+/* Writes VALUE to local APIC register REG. */
+static void
+lapic_write (int reg, uint32_t value)
+{
+  lapic[reg / sizeof *lapic] = value;
+
+  /* Wait for the write to finish, by reading. */
+  lapic_read (LAPIC_ID);
+}
+
+/* Enables the running CPU's local APIC, with all of its local
+   interrupts masked.  The BSP keeps its LINT0 and LINT1 as the
+   BIOS set them up, because they carry the PIC's interrupts and
+   NMI. */
+static void
+lapic_init (void)
+{
+  lapic_write (LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+  lapic_write (LAPIC_TIMER, LAPIC_LVT_MASKED);
+  if (cpu_current () != &cpus[0])
+    {
+      lapic_write (LAPIC_LINT0, LAPIC_LVT_MASKED);
+      lapic_write (LAPIC_LINT1, LAPIC_LVT_MASKED);
+    }
+  lapic_write (LAPIC_TPR, 0);
+  lapic_write (LAPIC_EOI, 0);
+}
+
+/* Measures lapic_timer_count, the local APIC timer count that
+   matches one tick of the PIT, using the BSP's local APIC. */
+static void
+lapic_calibrate (void)
+{
+  int64_t start;
+
+  lapic_write (LAPIC_TDCR, LAPIC_TDCR_16);
+
+  /* Wait for a timer tick to start. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    barrier ();
+
+  /* Count down from the top for CALIBRATE_TICKS ticks. */
+  lapic_write (LAPIC_TICR, UINT32_MAX);
+  start = timer_ticks ();
+  while (timer_elapsed (start) < CALIBRATE_TICKS)
+    barrier ();
+  lapic_timer_count = (UINT32_MAX - lapic_read (LAPIC_TCCR)) / CALIBRATE_TICKS;
+  lapic_write (LAPIC_TICR, 0);
+}
+
+/* Sends the IPI described by ICR, the low word of the interrupt
+   command register, to the CPU with local APIC ID LAPIC_ID, and
+   waits for it to be sent.  The local APIC is per-CPU, so only
+   our own interrupts need to be off, and the scheduler may call
+   this with run queues locked. */
+static void
+lapic_ipi (uint8_t lapic_id, uint32_t icr)
+{
+  enum intr_level old_level = intr_disable_local ();
+
+  lapic_write (LAPIC_ICR_HI, (uint32_t) lapic_id << 24);
+  lapic_write (LAPIC_ICR_LO, icr);
+  while (lapic_read (LAPIC_ICR_LO) & LAPIC_ICR_PENDING)
+    continue;
+
+  intr_set_level_local (old_level);
+}
+
+/* Routes the ISA interrupts through the I/O APICs listed in
+   MPC, and masks the 8259A PIC.  IMCR is true if the system
+   starts in PIC mode, in which case the IMCR must be switched to
+   let the I/O APICs reach the CPUs.  Returns the number of
+   interrupts routed; if it is 0, the PIC stays in charge.
+
+   Each IRQ keeps its vector 0x20 + IRQ, so the handlers that
+   intr_register_ext() installed need not change.  IRQ 0, the
+   timer, goes to the BSP, which keeps the global tick count; the
+   others go round-robin to all the CPUs that are online.  If the
+   MP table assigns no ISA interrupts, the ISA IRQs are assumed
+   to be wired to the inputs of the same number on the first I/O
+   APIC, as on most PCs, except for IRQ 2, the PIC cascade.  See
+   [MP-1.4] 5.1 and the 82093AA I/O APIC datasheet. */
+static int
+ioapic_route_isa (struct mp_config *mpc, bool imcr)
+{
+  static struct ioapic ioapics[IOAPIC_MAX];
+  struct isa_route routes[16];
+  enum intr_level old_level;
+  int ioapic_cnt = 0;
+  int isa_bus = -1;
+  int routed_cnt = 0;
+  bool assigned = false;
+  int next_cpu = 1;
+  uint8_t *p;
+  int i, j;
+
+  /* Map the I/O APICs and find the ISA bus.  Mapping may
+     allocate a page table, so it must happen with interrupts
+     on. */
+  p = (uint8_t *) (mpc + 1);
+  for (i = 0; i < mpc->entry_cnt; i++)
+    if (*p == MP_PROC)
+      p += sizeof (struct mp_proc);
+    else
+      {
+        if (*p == MP_IOAPIC)
+          {
+            struct mp_ioapic *e = (struct mp_ioapic *) p;
+            if ((e->flags & MP_IOAPIC_ENABLED) && ioapic_cnt < IOAPIC_MAX)
+              {
+                struct ioapic *a = &ioapics[ioapic_cnt++];
+                a->id = e->ioapic_id;
+                a->regs = map_mmio (e->paddr);
+                a->entry_cnt = ((ioapic_read (a, IOAPIC_VER) >> 16) & 0xff) + 1;
+              }
+          }
+        else if (*p == MP_BUS
+                 && !memcmp (((struct mp_bus *) p)->bus_type, "ISA", 3))
+          isa_bus = ((struct mp_bus *) p)->bus_id;
+        p += 8;
+      }
+  if (ioapic_cnt == 0)
+    return 0;
+
+  /* Find where each ISA IRQ arrives. */
+  for (i = 0; i < 16; i++)
+    routes[i].ioapic = NULL;
+  p = (uint8_t *) (mpc + 1);
+  for (i = 0; i < mpc->entry_cnt; i++)
+    if (*p == MP_PROC)
+      p += sizeof (struct mp_proc);
+    else
+      {
+        struct mp_intr *e = (struct mp_intr *) p;
+        if (*p == MP_INTR && e->intr_type == MP_INTR_INT
+            && e->src_bus == isa_bus && e->src_irq < 16)
+          for (j = 0; j < ioapic_cnt; j++)
+            if (ioapics[j].id == e->dst_ioapic
+                && e->dst_intin < ioapics[j].entry_cnt)
+              {
+                routes[e->src_irq].ioapic = &ioapics[j];
+                routes[e->src_irq].intin = e->dst_intin;
+                routes[e->src_irq].flags = e->flags;
+                assigned = true;
+              }
+        p += 8;
+      }
+  if (!assigned)
+    for (i = 0; i < 16 && i < ioapics[0].entry_cnt; i++)
+      if (i != 2)
+        {
+          routes[i].ioapic = &ioapics[0];
+          routes[i].intin = i;
+          routes[i].flags = 0;
+        }
+
+  /* Switch over with no device interrupt in flight. */
+  old_level = intr_disable ();
+  for (i = 0; i < ioapic_cnt; i++)
+    for (j = 0; j < ioapics[i].entry_cnt; j++)
+      ioapic_write (&ioapics[i], IOAPIC_REDTBL + 2 * j, IOAPIC_MASKED);
+  intr_pic_disable ();
+  if (imcr)
+    {
+      outb (0x22, 0x70);
+      outb (0x23, 0x01);
+    }
+  for (i = 0; i < 16; i++)
+    {
+      struct isa_route *r = &routes[i];
+      struct cpu *c;
+      uint32_t lo;
+
+      if (r->ioapic == NULL)
+        continue;
+      if (i == 0)
+        c = &cpus[0];
+      else
+        {
+          c = &cpus[next_cpu % cpu_cnt];
+          next_cpu++;
+        }
+
+      lo = 0x20 + i;
+      if ((r->flags & MP_INTR_POLARITY) == MP_INTR_ACTIVE_LOW)
+        lo |= IOAPIC_ACTIVE_LOW;
+      if ((r->flags & MP_INTR_TRIGGER) == MP_INTR_LEVEL)
+        lo |= IOAPIC_LEVEL;
+      ioapic_write (r->ioapic, IOAPIC_REDTBL + 2 * r->intin + 1,
+                    (uint32_t) c->lapic_id << 24);
+      ioapic_write (r->ioapic, IOAPIC_REDTBL + 2 * r->intin, lo);
+      routed_cnt++;
+    }
+  intr_set_level (old_level);
+
+  return routed_cnt;
+}
+
+/* Returns the value of register REG of I/O APIC A.  The caller
+   must keep other CPUs away from A's IOREGSEL, either by holding
+   the interrupt lock or, as at startup, by being alone. */
+static uint32_t
+ioapic_read (struct ioapic *a, int reg)
+{
+  a->regs[0] = reg;
+  return a->regs[4];
+}
+
+/* Writes VALUE to register REG of I/O APIC A, with the same
+   caveat as ioapic_read(). */
+static void
+ioapic_write (struct ioapic *a, int reg, uint32_t value)
+{
+  a->regs[0] = reg;
+  a->regs[4] = value;
+}
+
+/* Reschedule IPI handler.  Another CPU made a thread ready on
+   this one that should run now. */
+static void
+resched_interrupt (struct intr_frame *args UNUSED)
+{
+  thread_test_preemption ();
+}
+
+/* Local APIC timer interrupt handler, for the APs. */
+static void
+lapic_timer_interrupt (struct intr_frame *args)
+{
+  thread_tick (args);
+}
@@ -0,0 +1,79 @@
+#ifndef THREADS_SMP_H
+#define THREADS_SMP_H
+
+/* Maximum number of CPUs that we will bring online. */
+#define CPU_MAX 8
+
+/* Physical address at which ap-start.S is copied before the
+   application processors are started.  The startup IPI can only
+   name a page-aligned address below 1 MB. */
+#define AP_START_PADDR 0x8000
+
+/* Local APIC interrupt vectors.  Like the PIC's vectors
+   0x20...0x2f, these are external interrupts. */
+#define LAPIC_VEC_RESCHED 0xf0  /* Reschedule IPI. */
+#define LAPIC_VEC_TIMER 0xf1    /* Local APIC timer. */
+#define LAPIC_VEC_SPURIOUS 0xff /* Spurious interrupt. */
+
+#ifndef __ASSEMBLER__
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Per-CPU data.
+
+   cpus[0] is the bootstrap processor (BSP), which runs main()
+   and receives the timer interrupt.  The others are
+   application processors (APs) started by smp_init().  A CPU
+   finds its own struct cpu through the running thread (see
+   cpu_current()), so nothing here needs a special segment
+   register or a lookup of the local APIC ID.
+
+   Except for the fields written during startup, each CPU's
+   members are accessed only by that CPU, with its interrupts
+   off.  `curr' is written under the CPU's run queue lock, and
+   other CPUs read it and `idle_thread' without locking, as hints
+   for placing threads (see thread.c). */
+struct cpu
+  {
+    int id;                     /* Index in cpus[]. */
+    uint8_t lapic_id;           /* Local APIC ID. */
+    volatile bool started;      /* Finished booting? */
+
+    /* Owned by interrupt.c. */
+    bool in_external_intr;      /* Processing an external interrupt? */
+    bool yield_on_return;       /* Yield on interrupt return? */
+#ifdef INTR_LATENCY
+    uint64_t intr_off_tsc;      /* TSC when interrupts went off, or 0. */
+    const void *intr_off_caller; /* Code that turned them off. */
+#endif
+
+    /* Owned by thread.c. */
+    struct thread *curr;        /* Running thread. */
+    struct thread *idle_thread; /* This CPU's idle thread. */
+    int64_t ticks;              /* # of timer ticks on this CPU. */
+    unsigned slice_ticks;       /* # of timer ticks since last yield. */
+    long long idle_ticks;       /* # of timer ticks spent idle. */
+    long long kernel_ticks;     /* # of timer ticks in kernel threads. */
+    long long user_ticks;       /* # of timer ticks in user programs. */
+
+#ifdef USERPROG
+    /* Owned by userprog/tss.c. */
+    struct tss *tss;            /* Task-state segment. */
+
+    /* Owned by userprog/fpu.c. */
+    struct thread *fpu_owner;   /* Thread whose state the FPU holds. */
+#endif
+  };
+
+extern struct cpu cpus[CPU_MAX];
+extern int cpu_cnt;
+
+struct cpu *cpu_current (void);
+
+void smp_init (void);
+void smp_send_resched (struct cpu *);
+void lapic_eoi (void);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* threads/smp.h */
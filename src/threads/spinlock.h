@@ -0,0 +1,65 @@
+#ifndef THREADS_SPINLOCK_H
+#define THREADS_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* A spinlock, for mutual exclusion between CPUs.
+
+   A spinlock never sleeps, so it may be used with interrupts
+   off, but it also does not disable interrupts itself.  Holding
+   a spinlock with interrupts on invites deadlock against an
+   interrupt handler on the same CPU that wants the same lock, so
+   take one only after intr_disable_local(), and see interrupt.c
+   for the rules on mixing spinlocks with intr_disable().
+   Spinlocks protect the interrupt lock, the run queues and the
+   primitives in synch.h, along with a few small leaf structures
+   that the scheduler touches.  Other kernel code should use the
+   primitives in synch.h instead. */
+struct spinlock
+  {
+    volatile uint32_t locked;   /* 1 if held, 0 if free. */
+  };
+
+/* Initializes L as an unheld spinlock. */
+static inline void
+spinlock_init (struct spinlock *l)
+{
+  l->locked = 0;
+}
+
+/* Tries to acquire L without spinning.  Returns true if
+   successful, false if L is already held.
+
+   XCHG with a memory operand is implicitly locked, which makes
+   it a full memory barrier.  See [IA32-v2b] "XCHG". */
+static inline bool
+spinlock_try_acquire (struct spinlock *l)
+{
+  uint32_t old = 1;
+  asm volatile ("xchgl %0, %1" : "+r" (old), "+m" (l->locked) : : "memory");
+  return old == 0;
+}
+
+/* Acquires L, spinning until it becomes available.  While
+   waiting, only reads the lock, so that the waiting CPUs do not
+   fight over its cache line. */
+static inline void
+spinlock_acquire (struct spinlock *l)
+{
+  while (!spinlock_try_acquire (l))
+    while (l->locked)
+      asm volatile ("pause");
+}
+
+/* Releases L, which the caller must hold.  x86 does not reorder
+   a store with earlier loads or stores, so a compiler barrier
+   suffices. */
+static inline void
+spinlock_release (struct spinlock *l)
+{
+  asm volatile ("" : : : "memory");
+  l->locked = 0;
+}
+
+#endif /* threads/spinlock.h */
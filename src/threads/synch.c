@@ -29,9 +29,21 @@
 #include "threads/synch.h"
 #include <stdio.h>
 #include <string.h>
+#include "devices/timer.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Each semaphore, reader-writer lock and wait queue protects its
+   members with a spinlock of its own, taken with interrupts off
+   on the running CPU only (see interrupt.c), so that threads on
+   different CPUs using different primitives do not contend.  A
+   lock is a semaphore, plus priority donation, which crosses
+   from lock to lock and so is protected by donation_lock. */
+struct spinlock donation_lock;
+
+/* Protects the statistics in every struct lock_class. */
+static struct spinlock lockstat_lock;
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -48,6 +60,7 @@ sema_init (struct semaphore *sema, unsigned value)
 
   sema->value = value;
   list_init (&sema->waiters);
+  spinlock_init (&sema->lock);
 }
 
 /* Down or "P" operation on a semaphore.  Waits for SEMA's value
@@ -66,14 +79,17 @@ sema_down (struct semaphore *sema)
   ASSERT (sema != NULL);
   ASSERT (!intr_context ());
 
-  old_level = intr_disable ();
+  old_level = intr_disable_local ();
+  spinlock_acquire (&sema->lock);
   while (sema->value == 0) 
     {
       list_push_back (&sema->waiters, &thread_current ()->elem);
-      thread_block ();
+      thread_block_unlock (&sema->lock);
+      spinlock_acquire (&sema->lock);
     }
   sema->value--;
-  intr_set_level (old_level);
+  spinlock_release (&sema->lock);
+  intr_set_level_local (old_level);
 }
 
 /* Down or "P" operation on a semaphore, but only if the
@@ -89,7 +105,8 @@ sema_try_down (struct semaphore *sema)
 
   ASSERT (sema != NULL);
 
-  old_level = intr_disable ();
+  old_level = intr_disable_local ();
+  spinlock_acquire (&sema->lock);
   if (sema->value > 0) 
     {
       sema->value--;
@@ -97,13 +114,17 @@ sema_try_down (struct semaphore *sema)
     }
   else
     success = false;
-  intr_set_level (old_level);
+  spinlock_release (&sema->lock);
+  intr_set_level_local (old_level);
 
   return success;
 }
 
 /* Up or "V" operation on a semaphore.  Increments SEMA's value
-   and wakes up one thread of those waiting for SEMA, if any.
+   and wakes up the highest-priority thread of those waiting for
+   SEMA, if any, yielding to it if it has a higher priority than
+   the running thread.  Threads of equal priority are woken in
+   the order in which they started waiting.
 
    This function may be called from an interrupt handler. */
 void
@@ -113,50 +134,33 @@ sema_up (struct semaphore *sema)
 
   ASSERT (sema != NULL);
 
-  old_level = intr_disable ();
+  old_level = intr_disable_local ();
+  spinlock_acquire (&sema->lock);
   if (!list_empty (&sema->waiters)) 
-    thread_unblock (list_entry (list_pop_front (&sema->waiters),
-                                struct thread, elem));
+    {
+      struct list_elem *e = list_max (&sema->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
   sema->value++;
-  intr_set_level (old_level);
+  spinlock_release (&sema->lock);
+  thread_test_preemption ();
+  intr_set_level_local (old_level);
 }
 
-static void sema_test_helper (void *sema_);
+static void donate_priority (struct thread *);
+static void count_acquire (struct lock *, bool contended, int64_t start);
 
-/* Self-test for semaphores that makes control "ping-pong"
-   between a pair of threads.  Insert calls to printf() to see
-   what's going on. */
-void
-sema_self_test (void) 
-{
-  struct semaphore sema[2];
-  int i;
-
-  printf ("Testing semaphores...");
-  sema_init (&sema[0], 0);
-  sema_init (&sema[1], 0);
-  thread_create ("sema-test", PRI_DEFAULT, sema_test_helper, &sema);
-  for (i = 0; i < 10; i++) 
-    {
-      sema_up (&sema[0]);
-      sema_down (&sema[1]);
-    }
-  printf ("done.\n");
-}
+/* -lockstat: Collect lock statistics? */
+bool lock_stats_enabled;
 
-/* Thread function used by sema_self_test(). */
-static void
-sema_test_helper (void *sema_) 
-{
-  struct semaphore *sema = sema_;
-  int i;
+/* All lock classes that have been initialized, most recent
+   first.  A plain singly linked list, rather than a struct list,
+   because locks are initialized before any code could call
+   list_init() on it. */
+static struct lock_class *lock_classes;
 
-  for (i = 0; i < 10; i++) 
-    {
-      sema_down (&sema[0]);
-      sema_up (&sema[1]);
-    }
-}
 
 /* Initializes LOCK.  A lock can be held by at most a single
    thread at any given time.  Our locks are not "recursive", that
@@ -172,20 +176,51 @@ sema_test_helper (void *sema_)
    another one "up" it, but with a lock the same thread must both
    acquire and release it.  When these restrictions prove
    onerous, it's a good sign that a semaphore should be used,
-   instead of a lock. */
+   instead of a lock.
+
+   The lock_init() macro in synch.h calls this function with a
+   CLASS for the call site, which the first call registers for
+   lock_print_stats(). */
 void
-lock_init (struct lock *lock)
+lock_init_class (struct lock *lock, struct lock_class *class)
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
+  ASSERT (class != NULL);
 
   lock->holder = NULL;
   sema_init (&lock->semaphore, 1);
+  lock->class = class;
+  lock->acquire_tick = -1;
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&lockstat_lock);
+  if (!class->registered) 
+    {
+      class->next = lock_classes;
+      lock_classes = class;
+      class->registered = true;
+    }
+  spinlock_release (&lockstat_lock);
+  intr_set_level_local (old_level);
 }
 
 /* Acquires LOCK, sleeping until it becomes available if
    necessary.  The lock must not already be held by the current
    thread.
 
+   While we wait, our priority is donated to the lock's holder,
+   and onward along the chain of locks that it in turn is waiting
+   for, so that a lower-priority holder cannot indefinitely delay
+   us.  Donation is not used by the multi-level feedback queue
+   scheduler.
+
+   A free lock is taken under its semaphore's spinlock alone.
+   Only if we must wait do we take donation_lock, which comes
+   first in the locking order, so we drop the semaphore's
+   spinlock and take both.
+
    This function may sleep, so it must not be called within an
    interrupt handler.  This function may be called with
    interrupts disabled, but interrupts will be turned back on if
@@ -193,12 +228,77 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *curr = thread_current ();
+  struct semaphore *sema = &lock->semaphore;
+  enum intr_level old_level;
+  bool contended = false;
+  int64_t start = 0;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
-  sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  old_level = intr_disable_local ();
+  if (lock_stats_enabled)
+    start = timer_ticks ();
+  spinlock_acquire (&sema->lock);
+  if (sema->value == 0) 
+    {
+      contended = true;
+      spinlock_release (&sema->lock);
+      spinlock_acquire (&donation_lock);
+      spinlock_acquire (&sema->lock);
+      while (sema->value == 0) 
+        {
+          if (!thread_mlfqs) 
+            {
+              curr->waiting_lock = lock;
+              donate_priority (curr);
+            }
+          list_push_back (&sema->waiters, &curr->elem);
+          spinlock_release (&donation_lock);
+          thread_block_lock_wait (&sema->lock);
+          spinlock_acquire (&donation_lock);
+          spinlock_acquire (&sema->lock);
+        }
+      curr->waiting_lock = NULL;
+    }
+  sema->value--;
+  lock->holder = curr;
+  spinlock_release (&sema->lock);
+  if (contended)
+    spinlock_release (&donation_lock);
+  list_push_back (&curr->locks_held, &lock->elem);
+  if (lock_stats_enabled)
+    count_acquire (lock, contended, start);
+  intr_set_level_local (old_level);
+}
+
+/* Donates DONOR's priority along the chain of lock holders that
+   starts with the holder of the lock DONOR is waiting for,
+   stopping when a holder already has at least that priority or
+   after DONATION_DEPTH_MAX links.  Interrupts must be off and
+   donation_lock held. */
+static void
+donate_priority (struct thread *donor) 
+{
+  struct lock *lock = donor->waiting_lock;
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < DONATION_DEPTH_MAX; depth++) 
+    {
+      struct thread *holder;
+
+      if (lock == NULL || lock->holder == NULL)
+        break;
+      holder = lock->holder;
+      if (holder->priority >= donor->priority)
+        break;
+      thread_donate_priority (holder, donor->priority);
+      lock = holder->waiting_lock;
+    }
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -210,19 +310,37 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
-  success = sema_try_down (&lock->semaphore);
-  if (success)
-    lock->holder = thread_current ();
+  old_level = intr_disable_local ();
+  spinlock_acquire (&lock->semaphore.lock);
+  success = lock->semaphore.value > 0;
+  if (success) 
+    {
+      lock->semaphore.value--;
+      lock->holder = thread_current ();
+    }
+  spinlock_release (&lock->semaphore.lock);
+  if (success) 
+    {
+      list_push_back (&lock->holder->locks_held, &lock->elem);
+      if (lock_stats_enabled)
+        count_acquire (lock, false, timer_ticks ());
+    }
+  intr_set_level_local (old_level);
   return success;
 }
 
 /* Releases LOCK, which must be owned by the current thread.
-   This is lock_release function.
+   Any priority donated through LOCK is given up: our priority
+   is recalculated from the locks that we still hold.  No
+   priority was donated through a lock that nobody waits for,
+   so such a lock is released under its semaphore's spinlock
+   alone.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to release a lock within an interrupt
@@ -230,11 +348,104 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  struct thread *curr = thread_current ();
+  struct semaphore *sema = &lock->semaphore;
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
-  lock->holder = NULL;
-  sema_up (&lock->semaphore);
+  old_level = intr_disable_local ();
+  if (lock->acquire_tick >= 0) 
+    {
+      int64_t held = timer_ticks () - lock->acquire_tick;
+      spinlock_acquire (&lockstat_lock);
+      if (held > lock->class->max_hold_ticks)
+        lock->class->max_hold_ticks = held;
+      spinlock_release (&lockstat_lock);
+      lock->acquire_tick = -1;
+    }
+  list_remove (&lock->elem);
+
+  spinlock_acquire (&sema->lock);
+  if (list_empty (&sema->waiters)) 
+    {
+      lock->holder = NULL;
+      sema->value++;
+      spinlock_release (&sema->lock);
+    }
+  else 
+    {
+      struct list_elem *e;
+
+      spinlock_release (&sema->lock);
+      spinlock_acquire (&donation_lock);
+      spinlock_acquire (&sema->lock);
+      lock->holder = NULL;
+      e = list_max (&sema->waiters, thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+      sema->value++;
+      spinlock_release (&sema->lock);
+      if (!thread_mlfqs)
+        thread_refresh_priority (curr);
+      spinlock_release (&donation_lock);
+    }
+  thread_test_preemption ();
+  intr_set_level_local (old_level);
+
+  if (!intr_context ())
+    thread_rt_throttle ();
+}
+
+/* Counts an acquisition of LOCK in its class's statistics.
+   CONTENDED is true if the acquiring thread had to wait, which
+   it began to do at tick START.  Interrupts must be off. */
+static void
+count_acquire (struct lock *lock, bool contended, int64_t start) 
+{
+  struct lock_class *class = lock->class;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  lock->acquire_tick = timer_ticks ();
+  spinlock_acquire (&lockstat_lock);
+  class->acquire_cnt++;
+  if (contended) 
+    {
+      int64_t waited = lock->acquire_tick - start;
+      class->contend_cnt++;
+      class->wait_ticks += waited;
+      if (waited > class->max_wait_ticks)
+        class->max_wait_ticks = waited;
+    }
+  spinlock_release (&lockstat_lock);
+}
+
+/* Prints statistics for every class of locks that has been
+   acquired, if -lockstat was given. */
+void
+lock_print_stats (void) 
+{
+  struct lock_class *class;
+
+  if (!lock_stats_enabled)
+    return;
+
+  printf ("Locks: %-40s %9s %9s %9s %8s %8s\n", "class", "acquired",
+          "contended", "wait", "max wait", "max hold");
+  for (class = lock_classes; class != NULL; class = class->next)
+    if (class->acquire_cnt > 0) 
+      {
+        /* Drop the "../../" that the build directory adds. */
+        const char *name = class->name;
+        while (!memcmp (name, "../", 3))
+          name += 3;
+
+        printf ("       %-40s %9llu %9llu %9lld %8lld %8lld\n", name,
+                class->acquire_cnt, class->contend_cnt, class->wait_ticks,
+                class->max_wait_ticks, class->max_hold_ticks);
+      }
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -253,8 +464,12 @@ struct semaphore_elem
   {
     struct list_elem elem;              /* List element. */
     struct semaphore semaphore;         /* This semaphore. */
+    struct thread *thread;              /* Thread waiting on it. */
   };
 
+static bool waiter_priority_less (const struct list_elem *,
+                                  const struct list_elem *, void *aux);
+
 /* Initializes condition variable COND.  A condition variable
    allows one piece of code to signal a condition and cooperating
    code to receive the signal and act upon it. */
@@ -297,6 +512,7 @@ cond_wait (struct condition *cond, struct lock *lock)
   ASSERT (lock_held_by_current_thread (lock));
   
   sema_init (&waiter.semaphore, 0);
+  waiter.thread = thread_current ();
   list_push_back (&cond->waiters, &waiter.elem);
   lock_release (lock);
   sema_down (&waiter.semaphore);
@@ -304,8 +520,9 @@ cond_wait (struct condition *cond, struct lock *lock)
 }
 
 /* If any threads are waiting on COND (protected by LOCK), then
-   this function signals one of them to wake up from its wait.
-   LOCK must be held before calling this function.
+   this function signals the highest-priority one of them to wake
+   up from its wait.  LOCK must be held before calling this
+   function.
 
    An interrupt handler cannot acquire a lock, so it does not
    make sense to try to signal a condition variable within an
@@ -319,8 +536,26 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) 
-    sema_up (&list_entry (list_pop_front (&cond->waiters),
-                          struct semaphore_elem, elem)->semaphore);
+    {
+      struct list_elem *e = list_max (&cond->waiters,
+                                      waiter_priority_less, NULL);
+      list_remove (e);
+      sema_up (&list_entry (e, struct semaphore_elem, elem)->semaphore);
+    }
+}
+
+/* Returns true if the thread waiting on semaphore_elem A_ has a
+   lower priority than the one waiting on B_, false otherwise. */
+static bool
+waiter_priority_less (const struct list_elem *a_,
+                      const struct list_elem *b_, void *aux UNUSED) 
+{
+  const struct semaphore_elem *a = list_entry (a_, struct semaphore_elem,
+                                               elem);
+  const struct semaphore_elem *b = list_entry (b_, struct semaphore_elem,
+                                               elem);
+
+  return a->thread->priority < b->thread->priority;
 }
 
 /* Wakes up all threads, if any, waiting on COND (protected by
@@ -338,3 +573,308 @@ cond_broadcast (struct condition *cond, struct lock *lock)
   while (!list_empty (&cond->waiters))
     cond_signal (cond, lock);
 }
+
+static void rwlock_grant_write (struct rwlock *);
+static void rwlock_grant_read (struct rwlock *, int min_priority);
+static int max_waiter_priority (struct list *);
+
+/* Initializes RWLOCK.  A reader-writer lock may be held by any
+   number of readers at once or by a single writer, which
+   excludes the readers.  Like locks, reader-writer locks are not
+   recursive.
+
+   Writers are preferred: a thread that wants to read waits for
+   any waiting writer of the same or higher priority, so that a
+   stream of readers cannot starve a writer.  Among waiting
+   writers, the highest-priority one goes first.  A reader of
+   higher priority than every waiting writer does not wait for
+   them, only for a writer that holds the lock.
+
+   When the lock is released, it is handed directly to the
+   threads that get it next, so that none of them has to compete
+   for it again after waking up.  Priority is not donated
+   through reader-writer locks. */
+void
+rwlock_init (struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  rw->readers = 0;
+  rw->writer = NULL;
+  list_init (&rw->read_waiters);
+  list_init (&rw->write_waiters);
+  spinlock_init (&rw->lock);
+}
+
+/* Acquires RW for reading, sleeping until that is possible if
+   necessary.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_read (struct rwlock *rw) 
+{
+  struct thread *curr = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != curr);
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&rw->lock);
+  if (rw->writer != NULL
+      || max_waiter_priority (&rw->write_waiters) >= curr->priority) 
+    {
+      /* rwlock_grant_read() counts us as a reader before waking
+         us up. */
+      list_push_back (&rw->read_waiters, &curr->elem);
+      thread_block_lock_wait (&rw->lock);
+    }
+  else 
+    {
+      rw->readers++;
+      spinlock_release (&rw->lock);
+    }
+  intr_set_level_local (old_level);
+}
+
+/* Releases RW, which the current thread must hold for reading.
+   If this was the last reader, hands RW to a waiting writer, if
+   any. */
+void
+rwlock_release_read (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (rw->readers > 0);
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&rw->lock);
+  if (--rw->readers == 0 && !list_empty (&rw->write_waiters))
+    rwlock_grant_write (rw);
+  spinlock_release (&rw->lock);
+  thread_test_preemption ();
+  intr_set_level_local (old_level);
+}
+
+/* Acquires RW for writing, sleeping until that is possible if
+   necessary.  RW must not already be held by the current
+   thread.
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+rwlock_acquire_write (struct rwlock *rw) 
+{
+  struct thread *curr = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (rw != NULL);
+  ASSERT (!intr_context ());
+  ASSERT (rw->writer != curr);
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&rw->lock);
+  if (rw->writer != NULL || rw->readers > 0) 
+    {
+      /* rwlock_grant_write() makes us the writer before waking
+         us up. */
+      list_push_back (&rw->write_waiters, &curr->elem);
+      thread_block_lock_wait (&rw->lock);
+      ASSERT (rw->writer == curr);
+    }
+  else 
+    {
+      rw->writer = curr;
+      spinlock_release (&rw->lock);
+    }
+  intr_set_level_local (old_level);
+}
+
+/* Releases RW, which the current thread must hold for writing.
+   Hands RW to the highest-priority waiting thread, if any: if
+   that is a writer, to it alone, otherwise to every waiting
+   reader that is not held back by a waiting writer. */
+void
+rwlock_release_write (struct rwlock *rw) 
+{
+  enum intr_level old_level;
+  int writer_priority;
+
+  ASSERT (rw != NULL);
+  ASSERT (rwlock_write_held_by_current_thread (rw));
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&rw->lock);
+  rw->writer = NULL;
+  writer_priority = max_waiter_priority (&rw->write_waiters);
+  if (writer_priority >= max_waiter_priority (&rw->read_waiters)) 
+    {
+      if (!list_empty (&rw->write_waiters))
+        rwlock_grant_write (rw);
+    }
+  else
+    rwlock_grant_read (rw, writer_priority + 1);
+  spinlock_release (&rw->lock);
+  thread_test_preemption ();
+  intr_set_level_local (old_level);
+}
+
+/* Returns true if the current thread holds RW for writing, false
+   otherwise. */
+bool
+rwlock_write_held_by_current_thread (const struct rwlock *rw) 
+{
+  ASSERT (rw != NULL);
+
+  return rw->writer == thread_current ();
+}
+
+/* Makes the highest-priority waiting writer the holder of RW,
+   which must be free, and wakes it up.  RW's spinlock must be
+   held. */
+static void
+rwlock_grant_write (struct rwlock *rw) 
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rw->writer == NULL && rw->readers == 0);
+
+  e = list_max (&rw->write_waiters, thread_priority_less, NULL);
+  list_remove (e);
+  rw->writer = list_entry (e, struct thread, elem);
+  thread_unblock (rw->writer);
+}
+
+/* Counts every waiting reader of priority MIN_PRIORITY or higher
+   as a reader of RW and wakes it up.  RW's spinlock must be
+   held. */
+static void
+rwlock_grant_read (struct rwlock *rw, int min_priority) 
+{
+  struct list_elem *e;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rw->writer == NULL);
+
+  for (e = list_begin (&rw->read_waiters);
+       e != list_end (&rw->read_waiters); ) 
+    {
+      struct thread *t = list_entry (e, struct thread, elem);
+
+      e = list_next (e);
+      if (t->priority >= min_priority) 
+        {
+          list_remove (&t->elem);
+          rw->readers++;
+          thread_unblock (t);
+        }
+    }
+}
+
+/* Returns the highest priority among the threads on WAITERS, or
+   PRI_MIN - 1 if WAITERS is empty.  The spinlock that protects
+   WAITERS must be held. */
+static int
+max_waiter_priority (struct list *waiters) 
+{
+  if (list_empty (waiters))
+    return PRI_MIN - 1;
+  return list_entry (list_max (waiters, thread_priority_less, NULL),
+                     struct thread, elem)->priority;
+}
+
+/* Initializes wait queue WQ.  A wait queue lets threads sleep
+   until an arbitrary condition holds.  Code that might make the
+   condition true wakes the waiters, which then check it again.
+
+   Unlike a condition variable, a wait queue has no associated
+   lock: the condition is evaluated under the queue's own
+   spinlock, which makes checking it and going to sleep atomic
+   with respect to waitq_wake_one() and waitq_wake_all().  Thus,
+   a waker need only change the state that the condition depends
+   on and then wake the queue, and its wakeup cannot be lost. */
+void
+waitq_init (struct wait_queue *wq) 
+{
+  ASSERT (wq != NULL);
+
+  list_init (&wq->waiters);
+  spinlock_init (&wq->lock);
+}
+
+/* Sleeps on WQ until COND, called with AUX, returns true.  If it
+   already does, returns at once.  COND is called with interrupts
+   off and WQ's spinlock held, so it must not sleep or call
+   intr_disable().
+
+   This function may sleep, so it must not be called within an
+   interrupt handler. */
+void
+waitq_wait (struct wait_queue *wq, wait_cond_func *cond, void *aux) 
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+  ASSERT (cond != NULL);
+  ASSERT (!intr_context ());
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&wq->lock);
+  while (!cond (aux)) 
+    {
+      list_push_back (&wq->waiters, &thread_current ()->elem);
+      thread_block_unlock (&wq->lock);
+      spinlock_acquire (&wq->lock);
+    }
+  spinlock_release (&wq->lock);
+  intr_set_level_local (old_level);
+}
+
+/* Wakes up the highest-priority thread waiting on WQ, if any, to
+   recheck its condition.
+
+   This function may be called from an interrupt handler. */
+void
+waitq_wake_one (struct wait_queue *wq) 
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&wq->lock);
+  if (!list_empty (&wq->waiters)) 
+    {
+      struct list_elem *e = list_max (&wq->waiters,
+                                      thread_priority_less, NULL);
+      list_remove (e);
+      thread_unblock (list_entry (e, struct thread, elem));
+    }
+  spinlock_release (&wq->lock);
+  thread_test_preemption ();
+  intr_set_level_local (old_level);
+}
+
+/* Wakes up every thread waiting on WQ to recheck its condition.
+
+   This function may be called from an interrupt handler. */
+void
+waitq_wake_all (struct wait_queue *wq) 
+{
+  enum intr_level old_level;
+
+  ASSERT (wq != NULL);
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&wq->lock);
+  while (!list_empty (&wq->waiters))
+    thread_unblock (list_entry (list_pop_front (&wq->waiters),
+                                struct thread, elem));
+  spinlock_release (&wq->lock);
+  thread_test_preemption ();
+  intr_set_level_local (old_level);
+}
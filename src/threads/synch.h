@@ -3,32 +3,83 @@
 
 #include <list.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include "threads/spinlock.h"
 
 /* A counting semaphore. */
 struct semaphore 
   {
     unsigned value;             /* Current value. */
     struct list waiters;        /* List of waiting threads. */
+    struct spinlock lock;       /* Protects the members above. */
   };
 
 void sema_init (struct semaphore *, unsigned value);
 void sema_down (struct semaphore *);
 bool sema_try_down (struct semaphore *);
 void sema_up (struct semaphore *);
-void sema_self_test (void);
+
+/* Maximum length of a chain of priority donations, as in thread
+   A waiting on a lock held by B, which waits on a lock held by C,
+   and so on.  Donation stops propagating after this many links,
+   which bounds the time lock_acquire() spends with interrupts
+   off. */
+#define DONATION_DEPTH_MAX 8
+
+/* Protects priority donation: every thread's waiting_lock and
+   base_priority, and the waiter list and holder of every lock
+   that has waiters.  Taken before any semaphore's or run queue's
+   spinlock. */
+extern struct spinlock donation_lock;
+
+/* Statistics for a class of locks, that is, all the locks
+   initialized by one call to lock_init() in the source.  For
+   example, every malloc() descriptor's lock is in the same
+   class.  Collected only with the -lockstat kernel option. */
+struct lock_class
+  {
+    const char *name;           /* Source file and lock_init() argument. */
+    struct lock_class *next;    /* Next registered class. */
+    bool registered;            /* On the list of classes yet? */
+    unsigned long long acquire_cnt;  /* # of acquisitions. */
+    unsigned long long contend_cnt;  /* # that had to wait. */
+    int64_t wait_ticks;         /* Total ticks spent waiting. */
+    int64_t max_wait_ticks;     /* Longest wait, in ticks. */
+    int64_t max_hold_ticks;     /* Longest hold, in ticks. */
+  };
+
+/* -lockstat: Collect lock statistics? */
+extern bool lock_stats_enabled;
 
 /* Lock. */
 struct lock 
   {
-    struct thread *holder;      /* Thread holding lock (for debugging). */
-    struct semaphore semaphore; /* Binary semaphore controlling access. */
+    struct thread *holder;      /* Thread holding lock. */
+    struct semaphore semaphore; /* Binary semaphore controlling access.
+                                   Its waiters are the lock's donors. */
+    struct list_elem elem;      /* Element in holder's locks_held. */
+    struct lock_class *class;   /* Class for statistics. */
+    int64_t acquire_tick;       /* Tick at which holder acquired it,
+                                   or -1 if not counted. */
   };
 
-void lock_init (struct lock *);
+/* Initializes LOCK, as a member of a lock class named after the
+   call site. */
+#define lock_init(LOCK)                                                 \
+        do                                                              \
+          {                                                             \
+            static struct lock_class lock_class_ =                      \
+              { __FILE__ ": " #LOCK, NULL, false, 0, 0, 0, 0, 0 };      \
+            lock_init_class ((LOCK), &lock_class_);                     \
+          }                                                             \
+        while (0)
+
+void lock_init_class (struct lock *, struct lock_class *);
 void lock_acquire (struct lock *);
 bool lock_try_acquire (struct lock *);
 void lock_release (struct lock *);
 bool lock_held_by_current_thread (const struct lock *);
+void lock_print_stats (void);
 
 /* Condition variable. */
 struct condition 
@@ -41,6 +92,39 @@ void cond_wait (struct condition *, struct lock *);
 void cond_signal (struct condition *, struct lock *);
 void cond_broadcast (struct condition *, struct lock *);
 
+/* Reader-writer lock. */
+struct rwlock 
+  {
+    unsigned readers;           /* # of threads holding it to read. */
+    struct thread *writer;      /* Thread holding it to write, or null. */
+    struct list read_waiters;   /* Threads waiting to read. */
+    struct list write_waiters;  /* Threads waiting to write. */
+    struct spinlock lock;       /* Protects the members above. */
+  };
+
+void rwlock_init (struct rwlock *);
+void rwlock_acquire_read (struct rwlock *);
+void rwlock_release_read (struct rwlock *);
+void rwlock_acquire_write (struct rwlock *);
+void rwlock_release_write (struct rwlock *);
+bool rwlock_write_held_by_current_thread (const struct rwlock *);
+
+/* Wait queue. */
+struct wait_queue 
+  {
+    struct list waiters;        /* List of waiting threads. */
+    struct spinlock lock;       /* Protects waiters. */
+  };
+
+/* A condition to wait for.  Returns true if the condition holds,
+   given auxiliary data AUX. */
+typedef bool wait_cond_func (void *aux);
+
+void waitq_init (struct wait_queue *);
+void waitq_wait (struct wait_queue *, wait_cond_func *, void *aux);
+void waitq_wake_one (struct wait_queue *);
+void waitq_wake_all (struct wait_queue *);
+
 /* Optimization barrier.
 
    The compiler will not reorder operations across an
@@ -1,5 +1,6 @@
 #include "threads/thread.h"
 #include <debug.h>
+#include <inttypes.h>
 #include <stddef.h>
 #include <random.h>
 #include <stdio.h>
@@ -7,10 +8,15 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
+#include "threads/sched-trace.h"
+#include "threads/smp.h"
+#include "threads/spinlock.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#include "devices/timer.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
@@ -25,12 +31,67 @@
    Do not modify this value. */
 #define THREAD_BASIC 0xd42df210
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* Run queue: one list of processes in THREAD_READY state for
+   each priority, that is, processes that are ready to run but
+   not actually running.  Bit P of `bitmap' is set if and only
+   if lists[P] is nonempty, so the highest-priority ready thread
+   can be found with a single bit scan.  Ready real-time threads
+   are kept apart, in `rt_list', and run before all others in
+   order of earliest deadline.  Under the completely fair
+   scheduler, the other ready threads are kept in `tree' instead
+   of `lists', ordered by virtual run time, and under the stride
+   scheduler, likewise, ordered by pass.
+
+   Each CPU has its own run queue, runqueues[C->id] for CPU C,
+   and a ready thread T is always in the run queue of T->cpu.
+   A CPU runs only threads from its own queue, except that a CPU
+   with nothing to do steals from the busiest queue, and every
+   BALANCE_INTERVAL ticks a CPU pulls a thread from any queue
+   that is longer than its own by 2 or more.
+
+   Each run queue has a spinlock, which protects the queue and,
+   for each thread T whose T->cpu is the queue's CPU, T's status,
+   its priority, its place in the queue, and T->cpu itself.  A
+   CPU that switches threads holds its own queue's lock from
+   before the running thread stops until schedule_tail() has
+   marked the next one running, so a waker that locks T's queue
+   never finds T half switched out.  A thread moves to another
+   CPU only while both queues are locked, taking the lock of the
+   queue with the lower index first, or, when a CPU steals work
+   while holding its own lock, with spinlock_try_acquire(). */
+#define PRI_CNT (PRI_MAX - PRI_MIN + 1)
+struct runqueue
+  {
+    struct spinlock lock;       /* Protects this run queue. */
+    struct list lists[PRI_CNT]; /* Ready threads, by priority. */
+    uint64_t bitmap;            /* Bit P set iff lists[P] nonempty. */
+    struct list rt_list;        /* Ready real-time threads, by deadline. */
+    struct rb_tree tree;        /* Ready threads, by vruntime or pass. */
+    int64_t min_vruntime;       /* Least vruntime, never decreasing. */
+    int64_t min_pass;           /* Least pass, never decreasing. */
+    int cnt;                    /* # of threads in the run queue. */
+  };
+static struct runqueue runqueues[CPU_MAX];
+
+#define BALANCE_INTERVAL 20     /* # of timer ticks between balancing. */
+
+/* List of all processes.  Processes are added to this list
+   when they are created and removed when they exit. */
+static struct list all_list;
 
-/* Idle thread. */
-static struct thread *idle_thread;
+/* CPU usage of the user processes that have exited, so that it
+   can still be queried and printed afterward.  Only the most
+   recent EXITED_MAX are kept, in a ring: exited[N % EXITED_MAX]
+   is the Nth to exit.  Protected by disabling interrupts. */
+#define EXITED_MAX 32
+struct exited_process
+  {
+    tid_t tid;                  /* Thread identifier. */
+    char name[16];              /* Name. */
+    struct cpu_usage usage;     /* Final CPU usage. */
+  };
+static struct exited_process exited[EXITED_MAX];
+static size_t exited_cnt;       /* # of processes that have exited. */
 
 /* Initial thread, the thread running init.c:main(). */
 static struct thread *initial_thread;
@@ -38,6 +99,18 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Pages of threads that have exited, kept for reuse by
+   thread_create() so that short-lived threads do not go through
+   the page allocator.  Only the struct thread at the bottom of
+   a page is cleared when it is reused; the stack above it needs
+   no initialization.  Protected by page_cache_lock, since
+   schedule_tail() adds to it with interrupts off, which rules
+   out a struct lock. */
+#define PAGE_CACHE_MAX 16       /* Max # of pages in the cache. */
+static void *page_cache[PAGE_CACHE_MAX];
+static int page_cache_cnt;      /* # of pages in the cache. */
+static struct spinlock page_cache_lock;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -46,31 +119,182 @@ struct kernel_thread_frame
     void *aux;                  /* Auxiliary data for function. */
   };
 
-/* Statistics. */
-static long long idle_ticks;    /* # of timer ticks spent idle. */
-static long long kernel_ticks;  /* # of timer ticks in kernel threads. */
-static long long user_ticks;    /* # of timer ticks in user programs. */
-
-/* Scheduling. */
-#define TIME_SLICE 4            /* # of timer ticks to give each thread. */
-static unsigned thread_ticks;   /* # of timer ticks since last yield. */
+/* Scheduling.  Statistics and the tick count of the current
+   time slice are kept per-CPU, in struct cpu. */
+#define TIME_SLICE 4            /* Initial # of timer ticks per slice. */
+
+/* Adaptive time slices, off by default.
+
+   Each thread has its own time slice, which starts out as
+   TIME_SLICE ticks.  With "-slice-adapt", a thread that runs
+   until its slice is used up looks CPU-bound, so its slice
+   doubles, up to thread_slice_max, which cuts down on context
+   switches.  A thread that goes to sleep waiting for an event,
+   such as a timer or I/O, before its slice is up looks
+   I/O-bound, so its slice is halved, down to thread_slice_min,
+   which keeps it from holding the CPU for long if it turns
+   CPU-bound.  Waiting for a lock says nothing about the thread
+   itself, so it leaves the slice alone.
+
+   Under the multi-level feedback queue scheduler, which has its
+   own idea of how to treat CPU-bound threads, every thread keeps
+   TIME_SLICE, and the idle thread's slice never changes either.
+   The completely fair scheduler does not use slices at all. */
+bool thread_slice_adapt;
+unsigned thread_slice_min = 1;
+unsigned thread_slice_max = 16;
 
 /* If false (default), use round-robin scheduler.
    If true, use multi-level feedback queue scheduler.
    Controlled by kernel command-line option "-o mlfqs". */
 bool thread_mlfqs;
 
+/* Multi-level feedback queue scheduler state.
+
+   A thread's priority depends only on its recent_cpu and nice
+   values.  Between the once-per-second updates, recent_cpu
+   changes only for the running thread, so only the running
+   thread's priority needs to be recalculated every TIME_SLICE
+   ticks.  The once-per-second update then visits just the
+   threads on mlfqs_list: those with nonzero recent_cpu or nice.
+   The others are at a fixed point (recent_cpu stays 0 and
+   priority stays PRI_MAX), which in a system with many
+   long-sleeping threads is most of them. */
+static fixed_t load_avg;        /* System load average. */
+static struct list mlfqs_list;  /* Threads whose recent_cpu may change. */
+
+/* Real-time threads.
+
+   A real-time thread, created by thread_create_rt(), has a
+   period and a budget of ticks that it may run in each period.
+   Its deadline is the end of its current period, and the ready
+   real-time thread with the earliest deadline runs ahead of all
+   other threads (earliest deadline first, or EDF).  A thread
+   that uses up its budget sleeps until its next period begins,
+   so that a runaway real-time thread cannot starve the rest of
+   the system.
+
+   EDF meets every deadline as long as the sum of budget/period
+   over the real-time threads, their utilization, is at most 1,
+   so thread_create_rt() refuses any thread that would push it
+   past that.  The bound is for a single CPU, which makes it
+   conservative on a multiprocessor. */
+static fixed_t rt_utilization;  /* Sum of admitted threads' shares. */
+
+/* If true, use the completely fair scheduler.
+   Controlled by kernel command-line option "-cfs". */
+bool thread_cfs;
+
+/* Completely fair scheduler (CFS) state.
+
+   Each thread accumulates virtual run time (vruntime): the
+   nanoseconds it has run, scaled by NICE_0_WEIGHT / its weight,
+   where the weight depends on the thread's nice value.  The
+   ready thread with the least vruntime runs next, so over time
+   each thread's share of the CPU is proportional to its weight.
+   A run queue keeps its ready threads in a red-black tree, so
+   that choosing one takes O(1) time and queuing one O(lg n).
+
+   Priorities do not matter, except that real-time threads still
+   run first.  The running thread is preempted when its vruntime
+   exceeds the least ready thread's by CFS_GRANULARITY.
+
+   A run queue's min_vruntime tracks the least vruntime among its
+   threads.  A thread that blocks keeps its vruntime relative to
+   min_vruntime, and when it wakes, that is converted back to
+   the run queue it wakes on, but credited with no more than
+   CFS_SLEEP_CREDIT less than min_vruntime, so that a thread
+   cannot bank CPU time by sleeping. */
+#define NICE_0_WEIGHT 1024
+#define CFS_GRANULARITY (1000 * 1000 * 1000LL / TIMER_FREQ)
+#define CFS_SLEEP_CREDIT (2 * CFS_GRANULARITY)
+
+/* Weights by nice value, from NICE_MIN to NICE_MAX.  Each step
+   changes the weight by about 25%, which makes a difference of
+   about 10% in the CPU share of two competing threads. */
+static const int32_t cfs_weights[NICE_MAX - NICE_MIN + 1] = 
+  {
+    /* -20 */ 88761, 71755, 56483, 46273, 36291,
+    /* -15 */ 29154, 23254, 18705, 14949, 11916,
+    /* -10 */  9548,  7620,  6100,  4904,  3906,
+    /*  -5 */  3121,  2501,  1991,  1586,  1277,
+    /*   0 */  1024,   820,   655,   526,   423,
+    /*   5 */   335,   272,   215,   172,   137,
+    /*  10 */   110,    87,    70,    56,    45,
+    /*  15 */    36,    29,    23,    18,    15,
+    /*  20 */    12,
+  };
+
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+bool thread_stride;
+
+/* Stride scheduler state.
+
+   Each thread holds a number of tickets, and its stride is
+   STRIDE1 divided by its tickets.  Every timer tick that a
+   thread runs advances its pass by its stride, and the ready
+   thread with the least pass runs next, for a time slice.  A
+   thread with twice the tickets advances half as fast, so it
+   gets twice the ticks.  Unlike the completely fair scheduler,
+   which charges nanoseconds, this charges whole ticks, so the
+   shares come out the same from one run to the next.
+
+   A run queue's min_pass plays the role of min_vruntime: a
+   thread that blocks keeps its pass relative to it, and gets
+   that back when it wakes, with no credit for having slept. */
+#define STRIDE1 (1 << 20)
+
 static void kernel_thread (thread_func *, void *aux);
+static tid_t create_thread (const char *name, int priority,
+                            int64_t period, int64_t budget,
+                            thread_func *, void *aux);
 
 static void idle (void *aux UNUSED);
+static void idle_loop (void) NO_RETURN;
 static struct thread *running_thread (void);
-static struct thread *next_thread_to_run (void);
+static struct thread *next_thread_to_run (struct cpu *);
 static void init_thread (struct thread *, const char *name, int priority);
 static bool is_thread (struct thread *) UNUSED;
 static void *alloc_frame (struct thread *, size_t size);
-static void schedule (void);
+static void yield (enum sched_reason);
+static void block (struct thread *, bool event_wait);
+static void schedule (enum sched_reason);
 void schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static struct thread *alloc_thread_page (void);
+static void free_thread_page (struct thread *);
+static void set_effective_priority (struct thread *, int priority);
+static bool is_idle (struct thread *);
+static bool slice_adapts (struct thread *);
+static bool is_rt (const struct thread *);
+static bool precedes (const struct thread *, const struct thread *);
+static fixed_t rt_share (int64_t period, int64_t budget);
+static void rt_next_period (void);
+static bool rt_throttle_due (struct thread *);
+static bool deadline_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
+static struct cpu *select_cpu (struct thread *);
+static void migrate (struct thread *, struct cpu *);
+static void cfs_charge (struct thread *);
+static void cfs_place (struct thread *);
+static bool vruntime_less (const struct rb_elem *, const struct rb_elem *,
+                           void *aux);
+static void stride_charge (struct thread *);
+static bool pass_less (const struct rb_elem *, const struct rb_elem *,
+                       void *aux);
+static bool fair_sched (void);
+static void ready_push (struct thread *);
+static struct thread *ready_front (struct runqueue *);
+static struct thread *ready_pop (struct runqueue *);
+static void ready_remove (struct thread *);
+static struct runqueue *rq_lock_thread (struct thread *);
+static int ready_max_priority (const struct runqueue *);
+static bool steal (struct cpu *, int min_diff);
+static void mlfqs_tick (struct thread *);
+static void mlfqs_update_second (void);
+static void mlfqs_update_priority (struct thread *);
+static void mlfqs_activate (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -91,15 +315,33 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&ready_list);
+  for (i = 0; i < CPU_MAX; i++) 
+    {
+      int j;
+
+      spinlock_init (&runqueues[i].lock);
+      for (j = 0; j < PRI_CNT; j++)
+        list_init (&runqueues[i].lists[j]);
+      list_init (&runqueues[i].rt_list);
+      rb_init (&runqueues[i].tree,
+               thread_stride ? pass_less : vruntime_less, NULL);
+      cpus[i].id = i;
+    }
+  list_init (&all_list);
+  list_init (&mlfqs_list);
 
-  /* Set up a thread structure for the running thread. */
+  /* Set up a thread structure for the running thread, which runs
+     on the bootstrap processor. */
   initial_thread = running_thread ();
   init_thread (initial_thread, "main", PRI_DEFAULT);
   initial_thread->status = THREAD_RUNNING;
+  initial_thread->cpu = &cpus[0];
+  cpus[0].curr = initial_thread;
   initial_thread->tid = allocate_tid ();
 }
 
@@ -120,36 +362,282 @@ thread_start (void)
   sema_down (&idle_started);
 }
 
-/* Called by the timer interrupt handler at each timer tick.
-   Thus, this function runs in an external interrupt context. */
+/* Prepares C's idle thread, which will run on the stack of the
+   page that this function returns, and which the application
+   processor C itself turns into its idle thread when it calls
+   thread_start_ap().  Called by smp_init() on the bootstrap
+   processor, before C starts. */
+struct thread *
+thread_prepare_ap (struct cpu *c) 
+{
+  struct thread *t = palloc_get_page (PAL_ASSERT | PAL_ZERO);
+  enum intr_level old_level;
+  char name[16];
+
+  snprintf (name, sizeof name, "idle%d", c->id);
+  init_thread (t, name, PRI_MIN);
+  t->tid = allocate_tid ();
+
+  /* An idle thread takes no part in the multi-level feedback
+     queue scheduler, so undo what it inherited from us. */
+  old_level = intr_disable ();
+  if (t->mlfqs_active)
+    list_remove (&t->mlfqs_elem);
+  t->mlfqs_active = false;
+  t->nice = 0;
+  t->recent_cpu = 0;
+  t->status = THREAD_RUNNING;
+  t->cpu = c;
+  c->curr = c->idle_thread = t;
+  intr_set_level (old_level);
+
+  return t;
+}
+
+/* Becomes the idle thread of the running application processor,
+   which must have been prepared with thread_prepare_ap(), and
+   starts scheduling threads on it.  Interrupts must be off. */
 void
-thread_tick (void) 
+thread_start_ap (void) 
 {
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (thread_current () == cpu_current ()->idle_thread);
+
+  idle_loop ();
+}
+
+/* Returns the CPU that the caller is running on. */
+struct cpu *
+cpu_current (void) 
+{
+  return running_thread ()->cpu;
+}
+
+/* Called by the timer interrupt handler at each timer tick,
+   with F the interrupted code's frame.  Thus, this function runs
+   in an external interrupt context.  On the bootstrap processor
+   the tick comes from the PIT, on the others from the local
+   APIC timer. */
+void
+thread_tick (const struct intr_frame *f) 
+{
+  struct cpu *c = cpu_current ();
+  struct runqueue *rq = &runqueues[c->id];
   struct thread *t = thread_current ();
+  bool stole;
+
+  /* Update statistics.  The tick is charged to user mode if it
+     interrupted code running at a nonzero privilege level. */
+  c->ticks++;
+  if (t == c->idle_thread)
+    c->idle_ticks++;
+  else if ((f->cs & 3) != 0) 
+    {
+      c->user_ticks++;
+      t->usage.user_ticks++;
+    }
+  else 
+    {
+      c->kernel_ticks++;
+      t->usage.kernel_ticks++;
+    }
 
-  /* Update statistics. */
-  if (t == idle_thread)
-    idle_ticks++;
-#ifdef USERPROG
-  else if (t->pagedir != NULL)
-    user_ticks++;
-#endif
-  else
-    kernel_ticks++;
+  if (thread_mlfqs)
+    mlfqs_tick (t);
 
-  /* Enforce preemption. */
-  if (++thread_ticks >= TIME_SLICE)
+  /* Under the completely fair scheduler, charge the running
+     thread and let a thread that has fallen far enough behind it
+     take over. */
+  if (thread_cfs && !is_idle (t) && !is_rt (t)) 
+    {
+      spinlock_acquire (&rq->lock);
+      cfs_charge (t);
+      spinlock_release (&rq->lock);
+      thread_test_preemption ();
+    }
+  else if (thread_stride && !is_idle (t) && !is_rt (t)) 
+    {
+      spinlock_acquire (&rq->lock);
+      stride_charge (t);
+      spinlock_release (&rq->lock);
+    }
+
+  /* Enforce the real-time budget.  thread_preempt() puts the
+     thread to sleep until its next period. */
+  if (is_rt (t) && ++t->rt_used >= t->rt_budget)
     intr_yield_on_return ();
+
+  /* Even out the run queues. */
+  if (cpu_cnt > 1 && c->ticks % BALANCE_INTERVAL == 0) 
+    {
+      spinlock_acquire (&rq->lock);
+      stole = steal (c, 2);
+      spinlock_release (&rq->lock);
+      if (stole)
+        thread_test_preemption ();
+    }
+
+  /* Enforce preemption, and give a thread that used its whole
+     slice a longer one. */
+  if (!thread_cfs && ++c->slice_ticks >= t->slice) 
+    {
+      if (slice_adapts (t))
+        t->slice = t->slice * 2 < thread_slice_max ? t->slice * 2
+                                                   : thread_slice_max;
+      intr_yield_on_return ();
+    }
+}
+
+/* Accounts for CNT timer ticks that passed without a call to
+   thread_tick() because the idle thread had stopped the periodic
+   tick.  Only the idle thread can have been running, on the
+   only CPU. */
+void
+thread_tick_skipped (int64_t cnt) 
+{
+  ASSERT (cnt >= 0);
+  cpus[0].ticks += cnt;
+  cpus[0].idle_ticks += cnt;
 }
 
 /* Prints thread statistics. */
 void
 thread_print_stats (void) 
 {
+  long long idle_ticks = 0, kernel_ticks = 0, user_ticks = 0;
+  int i;
+
+  for (i = 0; i < cpu_cnt; i++) 
+    {
+      idle_ticks += cpus[i].idle_ticks;
+      kernel_ticks += cpus[i].kernel_ticks;
+      user_ticks += cpus[i].user_ticks;
+    }
   printf ("Thread: %lld idle ticks, %lld kernel ticks, %lld user ticks\n",
           idle_ticks, kernel_ticks, user_ticks);
 }
 
+/* Prints the CPU usage of the user processes that have exited,
+   up to the most recent EXITED_MAX of them, if there are any. */
+void
+thread_print_exited (void) 
+{
+  size_t i;
+
+  if (exited_cnt == 0)
+    return;
+  printf ("Exited processes:\n");
+  printf ("%5s %-16s %8s %8s %8s %8s %10s\n", "tid", "name",
+          "user", "kernel", "vol", "invol", "wait (us)");
+  for (i = exited_cnt > EXITED_MAX ? exited_cnt - EXITED_MAX : 0;
+       i < exited_cnt; i++) 
+    {
+      const struct exited_process *p = &exited[i % EXITED_MAX];
+      const struct cpu_usage *u = &p->usage;
+      printf ("%5d %-16s %8lld %8lld %8"PRIu32" %8"PRIu32" %10lld\n",
+              p->tid, p->name, u->user_ticks, u->kernel_ticks,
+              u->voluntary_cnt, u->involuntary_cnt, u->wait_ns / 1000);
+    }
+}
+
+/* Prints a table of the threads that have not exited, with the
+   CPU usage of each, followed by that of the user processes
+   that have exited. */
+void
+thread_print_table (void) 
+{
+  /* A row of the table. */
+  struct row 
+    {
+      tid_t tid;
+      char name[16];
+      enum thread_status status;
+      unsigned slice;
+      struct cpu_usage usage;
+    };
+  static const char *states[] = { "run", "ready", "block", "dying" };
+  enum intr_level old_level;
+  struct list_elem *e;
+  struct row *rows;
+  size_t row_cnt, i;
+
+  /* Printing may sleep, letting threads exit, so take a snapshot
+     of the table first.  Leave room for a few threads created
+     after counting. */
+  old_level = intr_disable ();
+  row_cnt = list_size (&all_list) + 8;
+  intr_set_level (old_level);
+  rows = malloc (row_cnt * sizeof *rows);
+  if (rows == NULL)
+    return;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&all_list), i = 0;
+       e != list_end (&all_list) && i < row_cnt; e = list_next (e), i++) 
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      rows[i].tid = t->tid;
+      strlcpy (rows[i].name, t->name, sizeof rows[i].name);
+      rows[i].status = t->status;
+      rows[i].slice = t->slice;
+      rows[i].usage = t->usage;
+    }
+  intr_set_level (old_level);
+  row_cnt = i;
+
+  printf ("%5s %-16s %-5s %5s %8s %8s %8s %8s %10s\n", "tid", "name",
+          "state", "slice", "user", "kernel", "vol", "invol", "wait (us)");
+  for (i = 0; i < row_cnt; i++) 
+    {
+      const struct cpu_usage *u = &rows[i].usage;
+      printf ("%5d %-16s %-5s %5u %8lld %8lld %8"PRIu32" %8"PRIu32
+              " %10lld\n", rows[i].tid, rows[i].name, states[rows[i].status],
+              rows[i].slice, u->user_ticks, u->kernel_ticks, u->voluntary_cnt,
+              u->involuntary_cnt, u->wait_ns / 1000);
+    }
+  free (rows);
+
+  thread_print_exited ();
+}
+
+/* Copies the CPU usage of the thread whose identifier is TID
+   into *USAGE.  TID may also be a user process that has exited,
+   if it is among the last EXITED_MAX to do so.  Returns true if
+   successful, false if there is no such thread. */
+bool
+thread_get_usage (tid_t tid, struct cpu_usage *usage) 
+{
+  enum intr_level old_level = intr_disable ();
+  struct list_elem *e;
+  bool found = false;
+  size_t i;
+
+  for (e = list_begin (&all_list); e != list_end (&all_list);
+       e = list_next (e)) 
+    {
+      struct thread *t = list_entry (e, struct thread, allelem);
+      if (t->tid == tid) 
+        {
+          *usage = t->usage;
+          found = true;
+          break;
+        }
+    }
+  for (i = 0; !found && i < exited_cnt && i < EXITED_MAX; i++) 
+    {
+      const struct exited_process *p
+        = &exited[(exited_cnt - 1 - i) % EXITED_MAX];
+      if (p->tid == tid) 
+        {
+          *usage = p->usage;
+          found = true;
+        }
+    }
+  intr_set_level (old_level);
+
+  return found;
+}
+
 /* Creates a new kernel thread named NAME with the given initial
    PRIORITY, which executes FUNCTION passing AUX as the argument,
    and adds it to the ready queue.  Returns the thread identifier
@@ -162,12 +650,105 @@ thread_print_stats (void)
    scheduled.  Use a semaphore or some other form of
    synchronization if you need to ensure ordering.
 
-   The code provided sets the new thread's `priority' member to
-   PRIORITY, but no actual priority scheduling is implemented.
-   Priority scheduling is the goal of Problem 1-3. */
+   If the new thread has a higher priority than the running
+   thread, the running thread yields to it immediately.  Under
+   the multi-level feedback queue scheduler, PRIORITY is ignored
+   and the new thread's priority is calculated from the nice and
+   recent_cpu values it inherits from the running thread. */
 tid_t
 thread_create (const char *name, int priority,
                thread_func *function, void *aux) 
+{
+  return create_thread (name, priority, 0, 0, function, aux);
+}
+
+/* Creates a real-time kernel thread named NAME, which executes
+   FUNCTION passing AUX as the argument.  Every PERIOD timer
+   ticks, starting now, the thread is guaranteed BUDGET ticks of
+   CPU time before the period ends, as long as it is ready to
+   run.  Returns the new thread's identifier, or TID_ERROR if
+   creation fails or if admitting the thread would make the
+   real-time threads' total utilization exceed 1.
+
+   The thread should call thread_rt_wait_period() when it has
+   finished its work for a period.  If it instead runs through
+   its budget, it is put to sleep until its next period, or, if
+   it holds any locks, as soon as it releases the last one.  If
+   it blocks and wakes up after its deadline, it starts a new
+   period at once, with a fresh budget.  A
+   real-time thread has priority PRI_MAX, which it donates to
+   the holder of any lock it waits for, but thread_set_priority()
+   and the multi-level feedback queue scheduler do not affect
+   when it runs. */
+tid_t
+thread_create_rt (const char *name, int64_t period, int64_t budget,
+                  thread_func *function, void *aux) 
+{
+  fixed_t share;
+  enum intr_level old_level;
+  tid_t tid;
+
+  ASSERT (period > 0);
+  ASSERT (0 < budget && budget <= period);
+
+  /* Admission control. */
+  share = rt_share (period, budget);
+  old_level = intr_disable ();
+  if (rt_utilization + share > FIX_ONE) 
+    {
+      intr_set_level (old_level);
+      return TID_ERROR;
+    }
+  rt_utilization += share;
+  intr_set_level (old_level);
+
+  tid = create_thread (name, PRI_MAX, period, budget, function, aux);
+  if (tid == TID_ERROR) 
+    {
+      old_level = intr_disable ();
+      rt_utilization -= share;
+      intr_set_level (old_level);
+    }
+  return tid;
+}
+
+/* Called by a real-time thread when it has finished its work
+   for the current period.  Sleeps until the next period begins.
+   If the current period is already over, the deadline was
+   missed: the thread continues at once, in the period that is
+   in progress. */
+void
+thread_rt_wait_period (void) 
+{
+  ASSERT (is_rt (thread_current ()));
+
+  rt_next_period ();
+}
+
+/* Called by lock_release() after the running thread releases a
+   lock.  If the thread is a real-time thread that used up its
+   budget while it held locks, sleeps until its next period now
+   that it holds none. */
+void
+thread_rt_throttle (void) 
+{
+  if (rt_throttle_due (thread_current ()))
+    rt_next_period ();
+}
+
+/* Returns the number of deadlines that the running real-time
+   thread has missed. */
+int
+thread_rt_get_misses (void) 
+{
+  return thread_current ()->rt_misses;
+}
+
+/* Creates and starts a thread for thread_create() or, if PERIOD
+   is nonzero, for thread_create_rt(). */
+static tid_t
+create_thread (const char *name, int priority, int64_t period,
+               int64_t budget, thread_func *function, void *aux) 
 {
   struct thread *t;
   struct kernel_thread_frame *kf;
@@ -178,13 +759,20 @@ thread_create (const char *name, int priority,
   ASSERT (function != NULL);
 
   /* Allocate thread. */
-  t = palloc_get_page (PAL_ZERO);
+  t = alloc_thread_page ();
   if (t == NULL)
     return TID_ERROR;
 
   /* Initialize thread. */
   init_thread (t, name, priority);
   tid = t->tid = allocate_tid ();
+  if (period != 0) 
+    {
+      t->rt_period = period;
+      t->rt_budget = budget;
+      t->rt_deadline = timer_ticks () + period;
+      t->priority = t->base_priority = PRI_MAX;
+    }
 
   /* Stack frame for kernel_thread(). */
   kf = alloc_frame (t, sizeof *kf);
@@ -202,6 +790,7 @@ thread_create (const char *name, int priority,
 
   /* Add to run queue. */
   thread_unblock (t);
+  thread_test_preemption ();
 
   return tid;
 }
@@ -209,17 +798,88 @@ thread_create (const char *name, int priority,
 /* Puts the current thread to sleep.  It will not be scheduled
    again until awoken by thread_unblock().
 
-   This function must be called with interrupts turned off.  It
-   is usually a better idea to use one of the synchronization
-   primitives in synch.h. */
+   This function must be called with interrupts turned off by
+   intr_disable(), whose interrupt lock makes going to sleep
+   atomic with whatever the caller did to arrange to be woken.
+   (The idle thread, which waits for nothing, may use
+   intr_disable_local() instead.)  It is usually a better idea to
+   use one of the synchronization primitives in synch.h. */
 void
 thread_block (void) 
 {
+  struct thread *curr = thread_current ();
+
   ASSERT (!intr_context ());
   ASSERT (intr_get_level () == INTR_OFF);
 
-  thread_current ()->status = THREAD_BLOCKED;
-  schedule ();
+  spinlock_acquire (&runqueues[curr->cpu->id].lock);
+  block (curr, true);
+}
+
+/* Puts the current thread to sleep, like thread_block(), for a
+   caller that keeps its waiters under spinlock LOCK, which it
+   holds, instead of the interrupt lock.  Releases LOCK once the
+   thread's run queue is locked, after which a waker that finds
+   the thread on the caller's wait list waits for the run queue
+   and so cannot wake the thread before it is asleep.  Interrupts
+   must be off.  Returns with LOCK released. */
+void
+thread_block_unlock (struct spinlock *lock) 
+{
+  struct thread *curr = thread_current ();
+
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spinlock_acquire (&runqueues[curr->cpu->id].lock);
+  spinlock_release (lock);
+  block (curr, true);
+}
+
+/* Like thread_block_unlock(), but for a thread that waits for
+   another thread to release a lock or rwlock, rather than for an
+   event.  Such a wait does not shorten the thread's time
+   slice. */
+void
+thread_block_lock_wait (struct spinlock *lock) 
+{
+  struct thread *curr = thread_current ();
+
+  ASSERT (!intr_context ());
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  spinlock_acquire (&runqueues[curr->cpu->id].lock);
+  spinlock_release (lock);
+  block (curr, false);
+}
+
+/* Puts CURR, the running thread, to sleep for one of the
+   thread_block*() functions.  Its run queue must be locked.
+   EVENT_WAIT is true if CURR waits for an event, false if it
+   waits for a lock. */
+static void
+block (struct thread *curr, bool event_wait) 
+{
+  /* Under the completely fair or stride scheduler, keep our
+     vruntime or pass relative to the run queue's while we sleep
+     (see cfs_place()). */
+  if (thread_cfs && !is_idle (curr) && !is_rt (curr)) 
+    {
+      cfs_charge (curr);
+      curr->vruntime -= runqueues[curr->cpu->id].min_vruntime;
+    }
+  else if (thread_stride && !is_idle (curr) && !is_rt (curr))
+    curr->pass -= runqueues[curr->cpu->id].min_pass;
+
+  /* We are waiting for an event before our time slice is up, so
+     shorten it. */
+  if (event_wait && slice_adapts (curr)
+      && curr->cpu->slice_ticks < curr->slice)
+    curr->slice = (curr->slice / 2 > thread_slice_min ? curr->slice / 2
+                   : thread_slice_min);
+
+  curr->status = THREAD_BLOCKED;
+  schedule (SCHED_BLOCK);
 }
 
 /* Transitions a blocked thread T to the ready-to-run state.
@@ -234,14 +894,57 @@ void
 thread_unblock (struct thread *t) 
 {
   enum intr_level old_level;
+  struct runqueue *rq;
 
   ASSERT (is_thread (t));
 
-  old_level = intr_disable ();
+  old_level = intr_disable_local ();
+  rq = rq_lock_thread (t);
   ASSERT (t->status == THREAD_BLOCKED);
-  list_push_back (&ready_list, &t->elem);
+  if (is_rt (t)) 
+    {
+      /* A real-time thread that slept through its deadline
+         starts a new period, instead of competing with a stale
+         deadline and budget. */
+      int64_t now = timer_ticks ();
+      if (now >= t->rt_deadline) 
+        {
+          t->rt_deadline = now + t->rt_period;
+          t->rt_used = 0;
+        }
+    }
+  if (thread_cfs && !is_rt (t))
+    cfs_place (t);
+  else if (thread_stride && !is_rt (t))
+    t->pass += rq->min_pass;
+  if (cpu_cnt > 1) 
+    {
+      struct cpu *c = select_cpu (t);
+      struct runqueue *new_rq = &runqueues[c->id];
+
+      /* Lock the new run queue as well, in order of index.  T is
+         blocked and we are the one waking it, so nothing else
+         moves it while neither lock is held. */
+      if (new_rq != rq) 
+        {
+          if (new_rq > rq)
+            spinlock_acquire (&new_rq->lock);
+          else if (!spinlock_try_acquire (&new_rq->lock)) 
+            {
+              spinlock_release (&rq->lock);
+              spinlock_acquire (&new_rq->lock);
+              spinlock_acquire (&rq->lock);
+            }
+          migrate (t, c);
+          spinlock_release (&rq->lock);
+          rq = new_rq;
+        }
+    }
   t->status = THREAD_READY;
-  intr_set_level (old_level);
+  t->ready_ns = timer_now_ns ();
+  ready_push (t);
+  spinlock_release (&rq->lock);
+  intr_set_level_local (old_level);
 }
 
 /* Returns the name of the running thread. */
@@ -282,17 +985,36 @@ thread_tid (void)
 void
 thread_exit (void) 
 {
+  struct thread *curr = thread_current ();
+  bool is_process = false;
+
   ASSERT (!intr_context ());
 
 #ifdef USERPROG
+  is_process = curr->pagedir != NULL;
   process_exit ();
 #endif
 
-  /* Just set our status to dying and schedule another process.
-     We will be destroyed during the call to schedule_tail(). */
+  /* Remove thread from all threads list, set our status to dying,
+     and schedule another process.  That process will destroy us
+     when it calls schedule_tail().  A user process leaves its
+     CPU usage behind in exited[]. */
   intr_disable ();
-  thread_current ()->status = THREAD_DYING;
-  schedule ();
+  if (is_process) 
+    {
+      struct exited_process *p = &exited[exited_cnt++ % EXITED_MAX];
+      p->tid = curr->tid;
+      strlcpy (p->name, curr->name, sizeof p->name);
+      p->usage = curr->usage;
+    }
+  list_remove (&curr->allelem);
+  if (curr->mlfqs_active)
+    list_remove (&curr->mlfqs_elem);
+  if (is_rt (curr))
+    rt_utilization -= rt_share (curr->rt_period, curr->rt_budget);
+  spinlock_acquire (&runqueues[curr->cpu->id].lock);
+  curr->status = THREAD_DYING;
+  schedule (SCHED_EXIT);
   NOT_REACHED ();
 }
 
@@ -300,25 +1022,163 @@ thread_exit (void)
    may be scheduled again immediately at the scheduler's whim. */
 void
 thread_yield (void) 
+{
+  yield (SCHED_YIELD);
+}
+
+/* Yields the CPU on behalf of the scheduler, because the running
+   thread used up its time slice or a higher-priority thread
+   became ready.  Otherwise the same as thread_yield(), except
+   that a real-time thread that has used up its budget sleeps
+   until its next period, unless it holds a lock.  Sleeping then
+   would stall every thread waiting for the lock, so instead
+   thread_rt_throttle() puts it to sleep when it releases its
+   last lock. */
+void
+thread_preempt (void) 
+{
+  if (rt_throttle_due (thread_current ()))
+    rt_next_period ();
+  else
+    yield (SCHED_PREEMPT);
+}
+
+/* Puts the running thread back in the run queue and schedules a
+   new one, for REASON. */
+static void
+yield (enum sched_reason reason) 
 {
   struct thread *curr = thread_current ();
   enum intr_level old_level;
   
   ASSERT (!intr_context ());
 
-  old_level = intr_disable ();
-  if (curr != idle_thread) 
-    list_push_back (&ready_list, &curr->elem);
+  old_level = intr_disable_local ();
+  spinlock_acquire (&runqueues[curr->cpu->id].lock);
+  if (thread_cfs && !is_idle (curr) && !is_rt (curr))
+    cfs_charge (curr);
   curr->status = THREAD_READY;
-  schedule ();
-  intr_set_level (old_level);
+  curr->ready_ns = timer_now_ns ();
+  if (!is_idle (curr)) 
+    ready_push (curr);
+  schedule (reason);
+  intr_set_level_local (old_level);
 }
 
-/* Sets the current thread's priority to NEW_PRIORITY. */
+/* Yields the CPU if a thread ready on this CPU should run ahead
+   of the running thread, or if the idle thread is running and
+   any thread is ready.  In an external interrupt context, the
+   yield is deferred until the interrupt returns.  The caller
+   must not hold a spinlock. */
+void
+thread_test_preemption (void) 
+{
+  enum intr_level old_level = intr_disable_local ();
+  struct cpu *c = cpu_current ();
+  struct runqueue *rq = &runqueues[c->id];
+  struct thread *next;
+  bool preempt;
+
+  spinlock_acquire (&rq->lock);
+  next = ready_front (rq);
+  preempt = (next != NULL
+             && (c->curr == c->idle_thread || precedes (next, c->curr)));
+  spinlock_release (&rq->lock);
+  intr_set_level_local (old_level);
+
+  if (!preempt)
+    return;
+  if (intr_context ())
+    intr_yield_on_return ();
+  else
+    thread_preempt ();
+}
+
+/* Sets the current thread's base priority to NEW_PRIORITY,
+   yielding if it no longer has the highest priority.  Priority
+   donated to the thread still applies: its effective priority
+   does not drop below that of any thread waiting on a lock it
+   holds.  Ignored under the multi-level feedback queue
+   scheduler, which sets priorities itself. */
 void
 thread_set_priority (int new_priority) 
 {
-  thread_current ()->priority = new_priority;
+  struct thread *curr = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (PRI_MIN <= new_priority && new_priority <= PRI_MAX);
+
+  if (thread_mlfqs)
+    return;
+
+  old_level = intr_disable_local ();
+  spinlock_acquire (&donation_lock);
+  curr->base_priority = new_priority;
+  thread_refresh_priority (curr);
+  spinlock_release (&donation_lock);
+  intr_set_level_local (old_level);
+
+  thread_test_preemption ();
+}
+
+/* Raises T's effective priority to PRIORITY, if that is higher,
+   on behalf of a thread waiting on a lock that T holds.
+   Interrupts must be off and donation_lock held. */
+void
+thread_donate_priority (struct thread *t, int priority) 
+{
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority > t->priority)
+    set_effective_priority (t, priority);
+}
+
+/* Recalculates T's effective priority as the maximum of its base
+   priority and the priorities of the threads waiting on the
+   locks that T still holds.  Interrupts must be off and
+   donation_lock held, which keeps the locks' waiter lists from
+   changing. */
+void
+thread_refresh_priority (struct thread *t) 
+{
+  int priority = t->base_priority;
+  struct list_elem *e;
+
+  ASSERT (is_thread (t));
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&t->locks_held); e != list_end (&t->locks_held);
+       e = list_next (e)) 
+    {
+      struct list *waiters = &list_entry (e, struct lock, elem)
+                               ->semaphore.waiters;
+      if (!list_empty (waiters)) 
+        {
+          struct thread *donor = list_entry (list_max (waiters,
+                                                       thread_priority_less,
+                                                       NULL),
+                                             struct thread, elem);
+          if (donor->priority > priority)
+            priority = donor->priority;
+        }
+    }
+
+  if (priority != t->priority)
+    set_effective_priority (t, priority);
+}
+
+/* Returns true if the thread owning list element A_ has a lower
+   priority than the one owning B_, false otherwise.  Both must
+   be linked through their `elem' members. */
+bool
+thread_priority_less (const struct list_elem *a_,
+                      const struct list_elem *b_, void *aux UNUSED) 
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->priority < b->priority;
 }
 
 /* Returns the current thread's priority. */
@@ -328,72 +1188,123 @@ thread_get_priority (void)
   return thread_current ()->priority;
 }
 
-/* Sets the current thread's nice value to NICE. */
+/* Sets the current thread's nice value to NICE and recalculates
+   its priority, yielding if it no longer has the highest
+   priority. */
 void
-thread_set_nice (int nice UNUSED) 
+thread_set_nice (int nice) 
 {
-  /* Not yet implemented. */
+  struct thread *t = thread_current ();
+  enum intr_level old_level;
+
+  ASSERT (NICE_MIN <= nice && nice <= NICE_MAX);
+
+  old_level = intr_disable ();
+  t->nice = nice;
+  if (thread_mlfqs) 
+    {
+      mlfqs_activate (t);
+      mlfqs_update_priority (t);
+    }
+  intr_set_level (old_level);
+
+  thread_test_preemption ();
 }
 
 /* Returns the current thread's nice value. */
 int
 thread_get_nice (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  return thread_current ()->nice;
 }
 
 /* Returns 100 times the system load average. */
 int
 thread_get_load_avg (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int load_avg_100 = fix_round (fix_mul_int (load_avg, 100));
+  intr_set_level (old_level);
+
+  return load_avg_100;
 }
 
 /* Returns 100 times the current thread's recent_cpu value. */
 int
 thread_get_recent_cpu (void) 
 {
-  /* Not yet implemented. */
-  return 0;
+  enum intr_level old_level = intr_disable ();
+  int recent_cpu_100 = fix_round (fix_mul_int (thread_current ()->recent_cpu,
+                                               100));
+  intr_set_level (old_level);
+
+  return recent_cpu_100;
+}
+
+/* Sets the current thread's number of tickets to TICKETS, which
+   sets its share of the CPU under the stride scheduler. */
+void
+thread_set_tickets (int tickets) 
+{
+  ASSERT (TICKETS_MIN <= tickets && tickets <= TICKETS_MAX);
+  thread_current ()->tickets = tickets;
+}
+
+/* Returns the current thread's number of tickets. */
+int
+thread_get_tickets (void) 
+{
+  return thread_current ()->tickets;
 }
 
 /* Idle thread.  Executes when no other thread is ready to run.
 
-   The idle thread is initially put on the ready list by
-   thread_start().  It will be scheduled once initially, at which
-   point it initializes idle_thread, "up"s the semaphore passed
-   to it to enable thread_start() to continue, and immediately
-   blocks.  After that, the idle thread never appears in the
-   ready list.  It is returned by next_thread_to_run() as a
-   special case when the ready list is empty. */
+   The bootstrap processor's idle thread is initially put on the
+   ready list by thread_start().  It will be scheduled once
+   initially, at which point it initializes the CPU's
+   idle_thread, "up"s the semaphore passed to it to enable
+   thread_start() to continue, and immediately blocks.  After
+   that, the idle thread never appears in the ready list.  It is
+   returned by next_thread_to_run() as a special case when the
+   ready list is empty.  Each application processor instead
+   turns its startup code into its idle thread; see
+   thread_start_ap(). */
 static void
 idle (void *idle_started_ UNUSED) 
 {
   struct semaphore *idle_started = idle_started_;
-  idle_thread = thread_current ();
+  enum intr_level old_level = intr_disable_local ();
+  cpu_current ()->idle_thread = thread_current ();
+  intr_set_level_local (old_level);
   sema_up (idle_started);
 
+  idle_loop ();
+}
+
+/* Body of every CPU's idle thread. */
+static void
+idle_loop (void) 
+{
   for (;;) 
     {
       /* Let someone else run. */
-      intr_disable ();
+      intr_disable_local ();
       thread_block ();
 
-      /* Re-enable interrupts and wait for the next one.
-
-         The `sti' instruction disables interrupts until the
-         completion of the next instruction, so these two
-         instructions are executed atomically.  This atomicity is
-         important; otherwise, an interrupt could be handled
-         between re-enabling interrupts and waiting for the next
-         one to occur, wasting as much as one clock tick worth of
-         time.
-
-         See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+      /* Zero free pages ahead of palloc_get_page (PAL_ZERO) until
+         there are enough of them.  A thread that becomes ready
+         meanwhile preempts us, as usual. */
+      intr_enable ();
+      while (palloc_zero_idle ())
+        continue;
+      intr_disable_local ();
+
+      /* Re-enable interrupts and wait for the next one.  In
+         tickless mode, the periodic timer tick is stopped first,
+         so that the next interrupt comes no sooner than
+         needed. */
+      timer_idle_enter ();
+      intr_enable_and_wait ();
     }
 }
 
@@ -434,16 +1345,46 @@ is_thread (struct thread *t)
 static void
 init_thread (struct thread *t, const char *name, int priority)
 {
+  struct thread *parent = running_thread ();
+  enum intr_level old_level;
+
   ASSERT (t != NULL);
   ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
   ASSERT (name != NULL);
 
   memset (t, 0, sizeof *t);
   t->status = THREAD_BLOCKED;
+  t->cpu = parent->cpu;
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
-  t->priority = priority;
+  t->priority = t->base_priority = priority;
+  t->slice = TIME_SLICE;
+  if (thread_slice_adapt && !thread_mlfqs) 
+    {
+      if (t->slice < thread_slice_min)
+        t->slice = thread_slice_min;
+      if (t->slice > thread_slice_max)
+        t->slice = thread_slice_max;
+    }
+  list_init (&t->locks_held);
   t->magic = THREAD_MAGIC;
+
+  old_level = intr_disable ();
+  if (t != parent) 
+    {
+      t->nice = parent->nice;
+      t->recent_cpu = parent->recent_cpu;
+      t->tickets = parent->tickets;
+    }
+  else
+    t->tickets = TICKETS_DEFAULT;
+  if (thread_mlfqs) 
+    {
+      mlfqs_activate (t);
+      mlfqs_update_priority (t);
+    }
+  list_push_back (&all_list, &t->allelem);
+  intr_set_level (old_level);
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
@@ -459,29 +1400,571 @@ alloc_frame (struct thread *t, size_t size)
   return t->stack;
 }
 
-/* Chooses and returns the next thread to be scheduled.  Should
-   return a thread from the run queue, unless the run queue is
-   empty.  (If the running thread can continue running, then it
-   will be in the run queue.)  If the run queue is empty, return
-   idle_thread. */
+/* Chooses and returns the next thread to be scheduled on CPU C.
+   Should return a thread from C's run queue, unless the run
+   queue is empty.  (If the running thread can continue running,
+   then it will be in the run queue.)  If the run queue is empty,
+   steal a thread from another CPU, and if there is none to steal
+   return C's idle thread. */
+static struct thread *
+next_thread_to_run (struct cpu *c) 
+{
+  struct runqueue *rq = &runqueues[c->id];
+
+  if (rq->cnt == 0 && (cpu_cnt == 1 || !steal (c, 1)))
+    return c->idle_thread;
+  else
+    return ready_pop (rq);
+}
+
+/* Returns true if T is the idle thread of the CPU it runs on. */
+static bool
+is_idle (struct thread *t) 
+{
+  return t == t->cpu->idle_thread;
+}
+
+/* Returns true if T's time slice should adapt to its behavior.
+   See the comment on thread_slice_adapt. */
+static bool
+slice_adapts (struct thread *t) 
+{
+  return thread_slice_adapt && !thread_mlfqs && !is_idle (t);
+}
+
+/* Returns true if T is a real-time thread. */
+static bool
+is_rt (const struct thread *t) 
+{
+  return t->rt_period != 0;
+}
+
+/* Returns true if thread A should run ahead of thread B: A is a
+   real-time thread and B is not, both are real-time threads and
+   A's deadline is earlier, or neither is and A has the higher
+   priority or, under the completely fair scheduler, a vruntime
+   lower by more than CFS_GRANULARITY or, under the stride
+   scheduler, a lower pass.  A and B must be on the same CPU. */
+static bool
+precedes (const struct thread *a, const struct thread *b) 
+{
+  if (is_rt (a) != is_rt (b))
+    return is_rt (a);
+  else if (is_rt (a))
+    return a->rt_deadline < b->rt_deadline;
+  else if (thread_cfs)
+    return a->vruntime + CFS_GRANULARITY < b->vruntime;
+  else if (thread_stride)
+    return a->pass < b->pass;
+  else
+    return a->priority > b->priority;
+}
+
+/* Returns the share of the CPU, BUDGET / PERIOD, that a
+   real-time thread needs, rounded up so that admission control
+   errs on the safe side. */
+static fixed_t
+rt_share (int64_t period, int64_t budget) 
+{
+  return (budget * FIX_ONE + period - 1) / period;
+}
+
+/* Ends the running real-time thread's current period: sleeps
+   until the next period begins and gives the thread a fresh
+   budget for it.  If the current period has already ended,
+   counts a missed deadline and skips ahead to the period in
+   progress. */
+static void
+rt_next_period (void) 
+{
+  struct thread *curr = thread_current ();
+  enum intr_level old_level = intr_disable ();
+  int64_t now = timer_ticks ();
+  int64_t release;
+
+  if (now > curr->rt_deadline) 
+    {
+      curr->rt_misses++;
+      curr->rt_deadline += ((now - curr->rt_deadline) / curr->rt_period
+                            * curr->rt_period);
+    }
+  release = curr->rt_deadline;
+  curr->rt_deadline += curr->rt_period;
+  curr->rt_used = 0;
+  timer_sleep_until (release);
+  intr_set_level (old_level);
+}
+
+/* Returns true if T is a real-time thread that has used up its
+   budget for the current period and holds no locks, so that it
+   should sleep until its next period. */
+static bool
+rt_throttle_due (struct thread *t) 
+{
+  return (is_rt (t) && t->rt_used >= t->rt_budget
+          && list_empty (&t->locks_held));
+}
+
+/* Returns true if the thread owning list element A_ has an
+   earlier deadline than the one owning B_, false otherwise. */
+static bool
+deadline_less (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED) 
+{
+  const struct thread *a = list_entry (a_, struct thread, elem);
+  const struct thread *b = list_entry (b_, struct thread, elem);
+
+  return a->rt_deadline < b->rt_deadline;
+}
+
+/* Chooses the CPU on which to make blocked thread T ready.
+   Prefers the CPU T last ran on, for its warm cache, unless that
+   CPU is busy with a thread that should run ahead of T and some
+   other CPU is idle.  Looks at the other CPUs without locking
+   their run queues, so the answer is only a hint.  Interrupts
+   must be off. */
+static struct cpu *
+select_cpu (struct thread *t) 
+{
+  struct cpu *c = t->cpu;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (c->curr == c->idle_thread || precedes (t, c->curr))
+    return c;
+  for (i = 0; i < cpu_cnt; i++)
+    if (cpus[i].curr == cpus[i].idle_thread
+        && runqueues[i].cnt == 0)
+      return &cpus[i];
+  return c;
+}
+
+/* Moves the highest-priority thread from the longest run queue
+   to CPU C's run queue, if the longest is longer than C's own
+   by at least MIN_DIFF threads.  Returns true if a thread was
+   moved, false otherwise.  C's run queue must be locked.  The
+   longest is locked with spinlock_try_acquire(), whatever the
+   order of the two, and if it is busy we give up until next
+   time. */
+static bool
+steal (struct cpu *c, int min_diff) 
+{
+  struct runqueue *rq = &runqueues[c->id];
+  struct runqueue *busiest = NULL;
+  int busiest_cnt = rq->cnt + min_diff - 1;
+  struct thread *t;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    if (runqueues[i].cnt > busiest_cnt) 
+      {
+        busiest = &runqueues[i];
+        busiest_cnt = busiest->cnt;
+      }
+  if (busiest == NULL || !spinlock_try_acquire (&busiest->lock))
+    return false;
+
+  /* The count may have changed before we locked it. */
+  if (busiest->cnt < rq->cnt + min_diff) 
+    {
+      spinlock_release (&busiest->lock);
+      return false;
+    }
+  t = ready_pop (busiest);
+  migrate (t, c);
+  ready_push (t);
+  spinlock_release (&busiest->lock);
+  return true;
+}
+
+/* Moves thread T, which must not be running or in a run queue,
+   to CPU C, carrying its vruntime or pass over to C's run
+   queue.  The run queues of T->cpu and C must both be
+   locked. */
+static void
+migrate (struct thread *t, struct cpu *c) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (thread_cfs && c != t->cpu)
+    t->vruntime += (runqueues[c->id].min_vruntime
+                    - runqueues[t->cpu->id].min_vruntime);
+  else if (thread_stride && c != t->cpu)
+    t->pass += (runqueues[c->id].min_pass
+                - runqueues[t->cpu->id].min_pass);
+  t->cpu = c;
+}
+
+/* Charges running thread T for the time since it was last
+   charged, under the completely fair scheduler, and advances its
+   run queue's min_vruntime.  T's run queue must be locked. */
+static void
+cfs_charge (struct thread *t) 
+{
+  struct runqueue *rq = &runqueues[t->cpu->id];
+  struct rb_elem *min = rb_min (&rq->tree);
+  int64_t now = timer_now_ns ();
+  int64_t min_vruntime;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->vruntime += ((now - t->exec_start) * NICE_0_WEIGHT
+                  / cfs_weights[t->nice - NICE_MIN]);
+  t->exec_start = now;
+
+  min_vruntime = t->vruntime;
+  if (min != NULL
+      && rb_entry (min, struct thread, rb_elem)->vruntime < min_vruntime)
+    min_vruntime = rb_entry (min, struct thread, rb_elem)->vruntime;
+  if (min_vruntime > rq->min_vruntime)
+    rq->min_vruntime = min_vruntime;
+}
+
+/* Converts the vruntime of thread T, which is waking up, from
+   relative to its run queue's min_vruntime back to absolute,
+   crediting it with no more than CFS_SLEEP_CREDIT for the time
+   it slept.  T's run queue must be locked. */
+static void
+cfs_place (struct thread *t) 
+{
+  int64_t min_vruntime = runqueues[t->cpu->id].min_vruntime;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->vruntime += min_vruntime;
+  if (t->vruntime < min_vruntime - CFS_SLEEP_CREDIT)
+    t->vruntime = min_vruntime - CFS_SLEEP_CREDIT;
+}
+
+/* Returns true if the thread owning tree element A_ has less
+   vruntime than the one owning B_, false otherwise. */
+static bool
+vruntime_less (const struct rb_elem *a_, const struct rb_elem *b_,
+               void *aux UNUSED) 
+{
+  const struct thread *a = rb_entry (a_, struct thread, rb_elem);
+  const struct thread *b = rb_entry (b_, struct thread, rb_elem);
+
+  return a->vruntime < b->vruntime;
+}
+
+/* Charges running thread T for one timer tick under the stride
+   scheduler, and advances its run queue's min_pass.  T's run
+   queue must be locked. */
+static void
+stride_charge (struct thread *t) 
+{
+  struct runqueue *rq = &runqueues[t->cpu->id];
+  struct rb_elem *min = rb_min (&rq->tree);
+  int64_t min_pass;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  t->pass += STRIDE1 / t->tickets;
+
+  min_pass = t->pass;
+  if (min != NULL && rb_entry (min, struct thread, rb_elem)->pass < min_pass)
+    min_pass = rb_entry (min, struct thread, rb_elem)->pass;
+  if (min_pass > rq->min_pass)
+    rq->min_pass = min_pass;
+}
+
+/* Returns true if the thread owning tree element A_ has a lower
+   pass than the one owning B_, false otherwise. */
+static bool
+pass_less (const struct rb_elem *a_, const struct rb_elem *b_,
+           void *aux UNUSED) 
+{
+  const struct thread *a = rb_entry (a_, struct thread, rb_elem);
+  const struct thread *b = rb_entry (b_, struct thread, rb_elem);
+
+  return a->pass < b->pass;
+}
+
+/* Returns true if run queues keep their ready threads, other
+   than real-time threads, in `tree' instead of `lists'. */
+static bool
+fair_sched (void) 
+{
+  return thread_cfs || thread_stride;
+}
+
+/* Sets T's effective priority to PRIORITY, moving T to the
+   matching run queue if it is ready.  Interrupts must be off,
+   and the caller must not hold a run queue's lock. */
+static void
+set_effective_priority (struct thread *t, int priority) 
+{
+  struct runqueue *rq;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (PRI_MIN <= priority && priority <= PRI_MAX);
+
+  rq = rq_lock_thread (t);
+  if (t->status == THREAD_READY) 
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+  spinlock_release (&rq->lock);
+}
+
+/* Locks the run queue of thread T's CPU and returns it.  If T is
+   ready, another CPU may move it until we hold the lock, so we
+   check that T->cpu still names the queue we locked.  Interrupts
+   must be off. */
+static struct runqueue *
+rq_lock_thread (struct thread *t) 
+{
+  for (;;) 
+    {
+      struct runqueue *rq = &runqueues[t->cpu->id];
+
+      spinlock_acquire (&rq->lock);
+      if (rq == &runqueues[t->cpu->id])
+        return rq;
+      spinlock_release (&rq->lock);
+    }
+}
+
+/* Adds ready thread T to the back of the run queue for its
+   priority on CPU T->cpu, or, if T is a real-time thread, after
+   the real-time threads with the same or earlier deadlines.  If
+   that is another CPU, and T should preempt the thread running
+   there, asks that CPU to reschedule.  T's run queue must be
+   locked. */
+static void
+ready_push (struct thread *t) 
+{
+  struct cpu *c = t->cpu;
+  struct runqueue *rq = &runqueues[c->id];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+  ASSERT (PRI_MIN <= t->priority && t->priority <= PRI_MAX);
+
+  if (is_rt (t))
+    list_insert_ordered (&rq->rt_list, &t->elem, deadline_less, NULL);
+  else if (fair_sched ())
+    rb_insert (&rq->tree, &t->rb_elem);
+  else 
+    {
+      list_push_back (&rq->lists[t->priority - PRI_MIN], &t->elem);
+      rq->bitmap |= (uint64_t) 1 << (t->priority - PRI_MIN);
+    }
+  rq->cnt++;
+
+  if (c != cpu_current ()
+      && (c->curr == c->idle_thread || precedes (t, c->curr)))
+    smp_send_resched (c);
+}
+
+/* Returns the thread that ready_pop() would remove from RQ, or a
+   null pointer if RQ is empty.  RQ must be locked. */
 static struct thread *
-next_thread_to_run (void) 
+ready_front (struct runqueue *rq) 
 {
-  if (list_empty (&ready_list))
-    return idle_thread;
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!list_empty (&rq->rt_list))
+    return list_entry (list_front (&rq->rt_list), struct thread, elem);
+  else if (fair_sched ())
+    return (rb_empty (&rq->tree) ? NULL
+            : rb_entry (rb_min (&rq->tree), struct thread, rb_elem));
+  else if (rq->bitmap != 0)
+    return list_entry (list_front (&rq->lists[ready_max_priority (rq)
+                                              - PRI_MIN]),
+                       struct thread, elem);
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return NULL;
 }
 
-/* Completes a thread switch by activating the new thread's page
-   tables, and, if the previous thread is dying, destroying it.
+/* Removes and returns the real-time thread with the earliest
+   deadline in RQ or, if there is none, the first thread in the
+   highest-priority nonempty list of RQ, which must not be empty.
+   RQ must be locked. */
+static struct thread *
+ready_pop (struct runqueue *rq) 
+{
+  struct thread *t;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (rq->cnt > 0);
+
+  if (!list_empty (&rq->rt_list))
+    t = list_entry (list_pop_front (&rq->rt_list), struct thread, elem);
+  else if (fair_sched ()) 
+    {
+      t = rb_entry (rb_min (&rq->tree), struct thread, rb_elem);
+      rb_remove (&rq->tree, &t->rb_elem);
+    }
+  else 
+    {
+      int idx = ready_max_priority (rq) - PRI_MIN;
+      struct list *queue = &rq->lists[idx];
+
+      t = list_entry (list_pop_front (queue), struct thread, elem);
+      if (list_empty (queue))
+        rq->bitmap &= ~((uint64_t) 1 << idx);
+    }
+  rq->cnt--;
+  return t;
+}
+
+/* Removes ready thread T from the run queue, for example to
+   requeue it after a change of priority.  T's run queue must be
+   locked. */
+static void
+ready_remove (struct thread *t) 
+{
+  struct runqueue *rq = &runqueues[t->cpu->id];
+  int idx = t->priority - PRI_MIN;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (t->status == THREAD_READY);
+
+  if (fair_sched () && !is_rt (t))
+    rb_remove (&rq->tree, &t->rb_elem);
+  else 
+    {
+      list_remove (&t->elem);
+      if (!is_rt (t) && list_empty (&rq->lists[idx]))
+        rq->bitmap &= ~((uint64_t) 1 << idx);
+    }
+  rq->cnt--;
+}
+
+/* Returns the priority of the highest-priority thread in RQ, or
+   PRI_MIN - 1 if RQ is empty.  RQ must be locked.
+
+   The bitmap is scanned a 32-bit half at a time so that
+   __builtin_clz() compiles to a single BSR instruction instead
+   of a call into libgcc, which the kernel does not link. */
+static int
+ready_max_priority (const struct runqueue *rq) 
+{
+  uint32_t hi = rq->bitmap >> 32;
+  uint32_t lo = rq->bitmap;
+
+  if (hi != 0)
+    return PRI_MIN + 63 - __builtin_clz (hi);
+  else if (lo != 0)
+    return PRI_MIN + 31 - __builtin_clz (lo);
+  else
+    return PRI_MIN - 1;
+}
+
+/* Multi-level feedback queue scheduler bookkeeping for the
+   timer tick, called from thread_tick() with T the running
+   thread.  The once-per-second update runs only on the
+   bootstrap processor, which owns the system timer. */
+static void
+mlfqs_tick (struct thread *t) 
+{
+  struct cpu *c = t->cpu;
+
+  if (!is_idle (t) && !is_rt (t)) 
+    {
+      t->recent_cpu = fix_add_int (t->recent_cpu, 1);
+      mlfqs_activate (t);
+    }
+
+  if (c == &cpus[0] && timer_ticks () % TIMER_FREQ == 0)
+    mlfqs_update_second ();
+  else if (c->ticks % TIME_SLICE == 0)
+    mlfqs_update_priority (t);
+
+  thread_test_preemption ();
+}
+
+/* Once-per-second update of the load average and of every
+   thread's recent_cpu and priority.  Threads not on mlfqs_list
+   are at a fixed point and are skipped. */
+static void
+mlfqs_update_second (void) 
+{
+  int ready_threads = 0;
+  fixed_t twice_load, coef;
+  struct list_elem *e;
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (i = 0; i < cpu_cnt; i++)
+    ready_threads += runqueues[i].cnt + (cpus[i].curr != cpus[i].idle_thread);
+
+  load_avg = fix_add (fix_mul (fix_frac (59, 60), load_avg),
+                      fix_mul_int (fix_frac (1, 60), ready_threads));
+
+  twice_load = fix_mul_int (load_avg, 2);
+  coef = fix_div (twice_load, fix_add_int (twice_load, 1));
+  for (e = list_begin (&mlfqs_list); e != list_end (&mlfqs_list); ) 
+    {
+      struct thread *t = list_entry (e, struct thread, mlfqs_elem);
+
+      e = list_next (e);
+      t->recent_cpu = fix_add_int (fix_mul (coef, t->recent_cpu), t->nice);
+      mlfqs_update_priority (t);
+      if (t->recent_cpu == 0 && t->nice == 0) 
+        {
+          list_remove (&t->mlfqs_elem);
+          t->mlfqs_active = false;
+        }
+    }
+}
+
+/* Recalculates T's priority from its recent_cpu and nice values,
+   moving it to the right run queue if it is ready.  The idle
+   threads and real-time threads keep their priorities.
+   Interrupts must be off. */
+static void
+mlfqs_update_priority (struct thread *t) 
+{
+  int priority = PRI_MAX - fix_trunc (fix_div_int (t->recent_cpu, 4))
+                 - t->nice * 2;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (priority < PRI_MIN)
+    priority = PRI_MIN;
+  else if (priority > PRI_MAX)
+    priority = PRI_MAX;
+
+  if (!is_idle (t) && !is_rt (t) && priority != t->priority)
+    set_effective_priority (t, priority);
+}
+
+/* Puts T on mlfqs_list if its recent_cpu or nice value has
+   become nonzero.  Interrupts must be off. */
+static void
+mlfqs_activate (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (!t->mlfqs_active && !is_idle (t) && !is_rt (t)
+      && (t->recent_cpu != 0 || t->nice != 0)) 
+    {
+      list_push_back (&mlfqs_list, &t->mlfqs_elem);
+      t->mlfqs_active = true;
+    }
+}
+
+/* Completes a thread switch by unlocking the run queue,
+   activating the new thread's page tables, and, if the previous
+   thread is dying, destroying it.
 
    At this function's invocation, we just switched from thread
-   PREV, the new thread is already running, and interrupts are
-   still disabled.  This function is normally invoked by
-   thread_schedule() as its final action before returning, but
-   the first time a thread is scheduled it is called by
-   switch_entry() (see switch.S).
+   PREV, the new thread is already running, interrupts are still
+   disabled, and the CPU's run queue is still locked.  This
+   function is normally invoked by thread_schedule() as its final
+   action before returning, but the first time a thread is
+   scheduled it is called by switch_entry() (see switch.S).
 
    It's not safe to call printf() until the thread switch is
    complete.  In practice that means that printf()s should be
@@ -496,11 +1979,16 @@ schedule_tail (struct thread *prev)
   
   ASSERT (intr_get_level () == INTR_OFF);
 
-  /* Mark us as running. */
+  /* Mark us as running.  From here on, with PREV off the CPU,
+     other CPUs may wake or steal it. */
   curr->status = THREAD_RUNNING;
+  curr->cpu->curr = curr;
+  spinlock_release (&runqueues[curr->cpu->id].lock);
 
   /* Start new time slice. */
-  thread_ticks = 0;
+  curr->cpu->slice_ticks = 0;
+  if (thread_cfs)
+    curr->exec_start = timer_now_ns ();
 
 #ifdef USERPROG
   /* Activate the new address space. */
@@ -515,31 +2003,53 @@ schedule_tail (struct thread *prev)
   if (prev != NULL && prev->status == THREAD_DYING && prev != initial_thread) 
     {
       ASSERT (prev != curr);
-      palloc_free_page (prev);
+      free_thread_page (prev);
     }
 }
 
-/* Schedules a new process.  At entry, interrupts must be off and
-   the running process's state must have been changed from
-   running to some other state.  This function finds another
-   thread to run and switches to it.
+/* Schedules a new process.  At entry, interrupts must be off,
+   the CPU's run queue must be locked, and the running process's
+   state must have been changed from running to some other
+   state, for REASON.  This function finds another thread to run
+   and switches to it.  The run queue is unlocked on return.
+
+   The interrupt lock, if this CPU holds it, is released for the
+   thread switched to, and taken back when the running thread
+   next runs.
    
    It's not safe to call printf() until schedule_tail() has
    completed. */
 static void
-schedule (void) 
+schedule (enum sched_reason reason) 
 {
   struct thread *curr = running_thread ();
-  struct thread *next = next_thread_to_run ();
+  bool held_intr_lock = intr_lock_drop ();
+  struct thread *next = next_thread_to_run (curr->cpu);
   struct thread *prev = NULL;
 
   ASSERT (intr_get_level () == INTR_OFF);
   ASSERT (curr->status != THREAD_RUNNING);
   ASSERT (is_thread (next));
 
+  /* Account for the switch. */
+  if (curr != next) 
+    {
+      if (reason == SCHED_PREEMPT)
+        curr->usage.involuntary_cnt++;
+      else if (reason != SCHED_EXIT)
+        curr->usage.voluntary_cnt++;
+    }
+  if (next->status == THREAD_READY)
+    next->usage.wait_ns += timer_now_ns () - next->ready_ns;
+
+  next->cpu = curr->cpu;
+  sched_trace_record (reason, curr, next);
   if (curr != next)
     prev = switch_threads (curr, next);
   schedule_tail (prev); 
+
+  if (held_intr_lock)
+    intr_lock_retake ();
 }
 
 /* Returns a tid to use for a new thread. */
@@ -556,6 +2066,45 @@ allocate_tid (void)
   return tid;
 }
 
+/* Returns a page for a new thread, from the page cache if
+   possible, or a null pointer if none is available.  The page's
+   contents are unspecified; init_thread() initializes the struct
+   thread. */
+static struct thread *
+alloc_thread_page (void) 
+{
+  enum intr_level old_level = intr_disable_local ();
+  void *page;
+
+  spinlock_acquire (&page_cache_lock);
+  page = page_cache_cnt > 0 ? page_cache[--page_cache_cnt] : NULL;
+  spinlock_release (&page_cache_lock);
+  intr_set_level_local (old_level);
+
+  return page != NULL ? page : palloc_get_page (0);
+}
+
+/* Frees the page of dying thread T, keeping it in the page cache
+   if there is room.  Interrupts must be off. */
+static void
+free_thread_page (struct thread *t) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  /* Clear the magic number, so that is_thread() still rejects
+     stale pointers to T. */
+  t->magic = 0;
+  spinlock_acquire (&page_cache_lock);
+  if (page_cache_cnt < PAGE_CACHE_MAX) 
+    {
+      page_cache[page_cache_cnt++] = t;
+      t = NULL;
+    }
+  spinlock_release (&page_cache_lock);
+  if (t != NULL)
+    palloc_free_page (t);
+}
+
 /* Offset of `stack' member within `struct thread'.
    Used by switch.S, which can't figure it out on its own. */
 uint32_t thread_stack_ofs = offsetof (struct thread, stack);
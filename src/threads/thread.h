@@ -1,9 +1,12 @@
 #ifndef THREADS_THREAD_H
 #define THREADS_THREAD_H
 
+#include <cpu-usage.h>
 #include <debug.h>
 #include <list.h>
+#include <rbtree.h>
 #include <stdint.h>
+#include "threads/fixed-point.h"
 
 /* States in a thread's life cycle. */
 enum thread_status
@@ -24,6 +27,17 @@ typedef int tid_t;
 #define PRI_DEFAULT 31                  /* Default priority. */
 #define PRI_MAX 63                      /* Highest priority. */
 
+/* Thread niceness, used by the multi-level feedback queue
+   scheduler. */
+#define NICE_MIN -20                    /* Nicest to other threads. */
+#define NICE_DEFAULT 0                  /* Default niceness. */
+#define NICE_MAX 20                     /* Least nice. */
+
+/* Thread tickets, used by the stride scheduler. */
+#define TICKETS_MIN 1                   /* Smallest share. */
+#define TICKETS_DEFAULT 100             /* Default share. */
+#define TICKETS_MAX 10000               /* Largest share. */
+
 /* A kernel thread or user process.
 
    Each thread structure is stored in its own 4 kB page.  The
@@ -74,12 +88,14 @@ typedef int tid_t;
    the `magic' member of the running thread's `struct thread' is
    set to THREAD_MAGIC.  Stack overflow will normally change this
    value, triggering the assertion. */
-/* The `elem' member has a dual purpose.  It can be an element in
-   the run queue (thread.c), or it can be an element in a
-   semaphore wait list (synch.c).  It can be used these two ways
-   only because they are mutually exclusive: only a thread in the
-   ready state is on the run queue, whereas only a thread in the
-   blocked state is on a semaphore wait list. */
+/* The `elem' member has a multiple purpose.  It can be an element
+   in the run queue (thread.c), an element in a semaphore wait
+   list (synch.c), or an element in the sleep list (timer.c).  It
+   can be used these ways only because they are mutually
+   exclusive: only a thread in the ready state is on the run
+   queue, whereas only a thread in the blocked state is on a
+   semaphore wait list or the sleep list, and a sleeping thread
+   is not waiting on a semaphore. */
 struct thread
   {
     /* Owned by thread.c. */
@@ -87,14 +103,63 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Effective priority. */
+    struct list_elem allelem;           /* List element for all threads list. */
+    struct cpu *cpu;                    /* CPU running or last to run. */
+
+    /* Shared between thread.c and synch.c, for priority
+       donation. */
+    int base_priority;                  /* Priority before donations. */
+    struct lock *waiting_lock;          /* Lock being waited for, if any. */
+    struct list locks_held;             /* Locks held by this thread. */
+
+    /* Owned by thread.c, for the multi-level feedback queue
+       scheduler only. */
+    int nice;                           /* Niceness. */
+    fixed_t recent_cpu;                 /* Recent CPU time received. */
+    bool mlfqs_active;                  /* On mlfqs_list? */
+    struct list_elem mlfqs_elem;        /* List element for mlfqs_list. */
+
+    /* Owned by thread.c, for the completely fair scheduler
+       only. */
+    int64_t vruntime;                   /* Weighted run time, in ns. */
+    int64_t exec_start;                 /* timer_now_ns() when last charged. */
+
+    /* Owned by thread.c, for the stride scheduler only. */
+    int tickets;                        /* Share of the CPU. */
+    int64_t pass;                       /* Virtual time of next quantum. */
+
+    /* Owned by thread.c, for the completely fair and stride
+       schedulers. */
+    struct rb_elem rb_elem;             /* Element in a run queue's tree. */
+
+    /* Owned by thread.c, for real-time threads only.  A thread
+       is real-time if rt_period is nonzero. */
+    int64_t rt_period;                  /* Period, in timer ticks. */
+    int64_t rt_budget;                  /* Ticks it may run per period. */
+    int64_t rt_deadline;                /* End of current period. */
+    int64_t rt_used;                    /* Ticks run in current period. */
+    int rt_misses;                      /* # of deadlines missed. */
+
+    /* Owned by thread.c. */
+    unsigned slice;                     /* Time slice length, in ticks. */
+
+    /* Owned by thread.c, for accounting. */
+    struct cpu_usage usage;             /* CPU time and switches. */
+    int64_t ready_ns;                   /* timer_now_ns() when made ready. */
 
-    /* Shared between thread.c and synch.c. */
+    /* Shared between thread.c, synch.c, and timer.c. */
     struct list_elem elem;              /* List element. */
 
+    /* Owned by devices/timer.c. */
+    int64_t wake_tick;                  /* Tick at which to wake up. */
+
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+
+    /* Owned by userprog/fpu.c. */
+    void *fpu_area;                     /* FPU save area, or null. */
 #endif
 
     /* Owned by thread.c. */
@@ -106,16 +171,51 @@ struct thread
    Controlled by kernel command-line option "-o mlfqs". */
 extern bool thread_mlfqs;
 
+/* If true, use the completely fair scheduler.
+   Controlled by kernel command-line option "-cfs". */
+extern bool thread_cfs;
+
+/* If true, adapt each thread's time slice to its behavior.
+   Controlled by kernel command-line option "-slice-adapt". */
+extern bool thread_slice_adapt;
+
+/* Bounds on the length of a thread's time slice, in timer
+   ticks, when slices adapt.  Controlled by kernel command-line
+   options "-slice-min" and "-slice-max". */
+extern unsigned thread_slice_min;
+extern unsigned thread_slice_max;
+
+/* If true, use the stride scheduler.
+   Controlled by kernel command-line option "-stride". */
+extern bool thread_stride;
+
+struct cpu;
+struct intr_frame;
+struct spinlock;
+
 void thread_init (void);
 void thread_start (void);
+struct thread *thread_prepare_ap (struct cpu *);
+void thread_start_ap (void) NO_RETURN;
 
-void thread_tick (void);
+void thread_tick (const struct intr_frame *);
+void thread_tick_skipped (int64_t cnt);
 void thread_print_stats (void);
+void thread_print_table (void);
+void thread_print_exited (void);
+bool thread_get_usage (tid_t, struct cpu_usage *);
 
 typedef void thread_func (void *aux);
 tid_t thread_create (const char *name, int priority, thread_func *, void *);
+tid_t thread_create_rt (const char *name, int64_t period, int64_t budget,
+                        thread_func *, void *);
+void thread_rt_wait_period (void);
+void thread_rt_throttle (void);
+int thread_rt_get_misses (void);
 
 void thread_block (void);
+void thread_block_unlock (struct spinlock *);
+void thread_block_lock_wait (struct spinlock *);
 void thread_unblock (struct thread *);
 
 struct thread *thread_current (void);
@@ -124,13 +224,21 @@ const char *thread_name (void);
 
 void thread_exit (void) NO_RETURN;
 void thread_yield (void);
+void thread_preempt (void);
+void thread_test_preemption (void);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_donate_priority (struct thread *, int priority);
+void thread_refresh_priority (struct thread *);
+bool thread_priority_less (const struct list_elem *,
+                           const struct list_elem *, void *aux);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
 int thread_get_recent_cpu (void);
+int thread_get_tickets (void);
+void thread_set_tickets (int);
 int thread_get_load_avg (void);
 
 #endif /* threads/thread.h */
@@ -0,0 +1,115 @@
+#include "threads/workqueue.h"
+#include <debug.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Queued work items, oldest first.  Protected by turning
+   interrupts off, because interrupt handlers add to it. */
+static struct list work_list;
+
+/* Upped once for each item added to work_list. */
+static struct semaphore work_sema;
+
+/* The worker thread, once workqueue_start() has created it. */
+static struct thread *worker;
+
+static thread_func worker_thread;
+
+/* Initializes the work queue.  Work may be queued from then on,
+   but none is done until workqueue_start() is called. */
+void
+workqueue_init (void) 
+{
+  list_init (&work_list);
+  sema_init (&work_sema, 0);
+}
+
+/* Creates the worker thread.  Call after thread_start(). */
+void
+workqueue_start (void) 
+{
+  struct semaphore started;
+
+  sema_init (&started, 0);
+  if (thread_create ("worker", PRI_MAX, worker_thread, &started)
+      == TID_ERROR)
+    PANIC ("could not create worker thread");
+  sema_down (&started);
+}
+
+/* Returns true if the running thread is the worker thread, that
+   is, if the caller is a work function. */
+bool
+workqueue_in_worker (void) 
+{
+  return worker != NULL && thread_current () == worker;
+}
+
+/* Initializes W as a work item that, whenever queued, calls
+   FUNC, passing AUX. */
+void
+work_init (struct work *w, work_func *func, void *aux) 
+{
+  ASSERT (w != NULL);
+  ASSERT (func != NULL);
+
+  w->func = func;
+  w->aux = aux;
+  w->pending = false;
+}
+
+/* Queues W for the worker thread.  Returns true if successful,
+   false if W was already queued and not yet started, in which
+   case its function will still run once.  If W has started, it
+   runs again after it finishes, so a function always sees
+   anything that happened before the call that queued it.
+
+   May be called from an external interrupt handler. */
+bool
+work_queue (struct work *w) 
+{
+  enum intr_level old_level;
+  bool queued;
+
+  ASSERT (w != NULL);
+
+  old_level = intr_disable ();
+  queued = !w->pending;
+  if (queued) 
+    {
+      w->pending = true;
+      list_push_back (&work_list, &w->elem);
+      sema_up (&work_sema);
+    }
+  intr_set_level (old_level);
+
+  return queued;
+}
+
+/* Worker thread.  Runs queued work items in order, forever. */
+static void
+worker_thread (void *started_) 
+{
+  struct semaphore *started = started_;
+
+  /* Stay ahead of ordinary threads under the multi-level
+     feedback queue scheduler, too. */
+  thread_set_nice (NICE_MIN);
+  worker = thread_current ();
+  sema_up (started);
+
+  for (;;) 
+    {
+      enum intr_level old_level;
+      struct work *w;
+
+      sema_down (&work_sema);
+      old_level = intr_disable ();
+      w = list_entry (list_pop_front (&work_list), struct work, elem);
+      w->pending = false;
+      intr_set_level (old_level);
+
+      w->func (w->aux);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef THREADS_WORKQUEUE_H
+#define THREADS_WORKQUEUE_H
+
+#include <list.h>
+#include <stdbool.h>
+
+/* Deferred work.
+
+   An external interrupt handler runs with interrupts off, which
+   delays every other interrupt, including the timer tick.  A
+   handler with more than a little to do should do only what
+   cannot wait, such as acknowledging the device, and queue a
+   work item with work_queue() for the rest.  The worker thread,
+   which has priority PRI_MAX, then calls the item's function in
+   an ordinary kernel thread context, with interrupts on.
+
+   Items run one at a time, in the order they were queued.  A
+   work function may sleep briefly, for example on a lock, but it
+   must not wait for other work to be done, because that work
+   cannot run until it returns. */
+
+typedef void work_func (void *aux);
+
+/* A work item. */
+struct work
+  {
+    struct list_elem elem;      /* Element in the work queue. */
+    work_func *func;            /* Function to call. */
+    void *aux;                  /* Auxiliary data for FUNC. */
+    bool pending;               /* Queued but not yet started? */
+  };
+
+void workqueue_init (void);
+void workqueue_start (void);
+bool workqueue_in_worker (void);
+
+void work_init (struct work *, work_func *, void *aux);
+bool work_queue (struct work *);
+
+#endif /* threads/workqueue.h */
@@ -1,6 +1,7 @@
 #include "userprog/exception.h"
 #include <inttypes.h>
 #include <stdio.h>
+#include "userprog/fpu.h"
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
@@ -10,6 +11,7 @@ static long long page_fault_cnt;
 
 static void kill (struct intr_frame *);
 static void page_fault (struct intr_frame *);
+static void device_not_available (struct intr_frame *);
 
 /* Registers handlers for interrupts that can be caused by user
    programs.
@@ -45,8 +47,6 @@ exception_init (void)
   intr_register_int (0, 0, INTR_ON, kill, "#DE Divide Error");
   intr_register_int (1, 0, INTR_ON, kill, "#DB Debug Exception");
   intr_register_int (6, 0, INTR_ON, kill, "#UD Invalid Opcode Exception");
-  intr_register_int (7, 0, INTR_ON, kill,
-                     "#NM Device Not Available Exception");
   intr_register_int (11, 0, INTR_ON, kill, "#NP Segment Not Present");
   intr_register_int (12, 0, INTR_ON, kill, "#SS Stack Fault Exception");
   intr_register_int (13, 0, INTR_ON, kill, "#GP General Protection Exception");
@@ -58,6 +58,12 @@ exception_init (void)
      We need to disable interrupts for page faults because the
      fault address is stored in CR2 and needs to be preserved. */
   intr_register_int (14, 0, INTR_OFF, page_fault, "#PF Page-Fault Exception");
+
+  /* #NM is how we switch FPU state lazily (see fpu.c).  The
+     handler must not be preempted between making the running
+     thread the FPU owner and returning to it. */
+  intr_register_int (7, 0, INTR_OFF, device_not_available,
+                     "#NM Device Not Available Exception");
 }
 
 /* Prints exception statistics. */
@@ -108,6 +114,20 @@ kill (struct intr_frame *f)
     }
 }
 
+/* Device-not-available exception handler.  A user process
+   executed an FPU instruction with CR0.TS set, so load its FPU
+   state.  The kernel is compiled with -msoft-float, so an #NM
+   in kernel code is a bug, which kill() reports. */
+static void
+device_not_available (struct intr_frame *f) 
+{
+  if (f->cs != SEL_UCSEG || !fpu_load ()) 
+    {
+      intr_enable ();
+      kill (f);
+    }
+}
+
 /* Page fault handler.  This is a skeleton that must be filled in
    to implement virtual memory.  Some solutions to project 2 may
    also require modifying this code.
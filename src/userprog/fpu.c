@@ -0,0 +1,224 @@
+#include "userprog/fpu.h"
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/smp.h"
+#include "threads/thread.h"
+
+/* Lazy FPU context switching.
+
+   The kernel itself is compiled with -msoft-float and never
+   touches the x87 FPU or the SSE registers, so only user
+   programs have FPU state, and most of them never use it.
+   Instead of saving and restoring the FPU registers on every
+   thread switch, each CPU remembers the thread whose state its
+   FPU holds, its "FPU owner", and sets CR0.TS whenever it runs
+   any other thread.  The first FPU instruction that such a
+   thread executes then raises a #NM exception, whose handler
+   calls fpu_load() to save the owner's state, load the running
+   thread's, and clear CR0.TS.  A thread's save area is allocated
+   at its first FPU instruction.
+
+   On a multiprocessor, a thread may next run on a CPU other
+   than the one whose FPU holds its state, so there the owner's
+   state is saved as soon as another thread runs; only loading
+   it stays lazy.
+
+   See [IA32-v3a] 2.5 "Control Registers" and 10.5 "FXSAVE and
+   FXRSTOR Instructions". */
+
+/* CR0 and CR4 bits. */
+#define CR0_MP 0x00000002       /* Monitor Coprocessor. */
+#define CR0_EM 0x00000004       /* (Floating-point) Emulation. */
+#define CR0_TS 0x00000008       /* Task Switched. */
+#define CR0_NE 0x00000020       /* Numeric Error. */
+#define CR4_OSFXSR 0x00000200   /* OS supports FXSAVE and FXRSTOR. */
+#define CR4_OSXMMEXCPT 0x00000400 /* OS supports #XF exceptions. */
+
+/* CPUID leaf 1 EDX bits. */
+#define CPUID_FXSR 0x01000000   /* FXSAVE and FXRSTOR. */
+#define CPUID_SSE 0x02000000    /* SSE. */
+
+/* Size and alignment of a save area.  FNSAVE needs only 108
+   bytes and no alignment. */
+#define FPU_AREA_SIZE 512
+#define FPU_AREA_ALIGN 16
+
+/* True if the CPU has FXSAVE and FXRSTOR, which also cover the
+   SSE registers.  Otherwise we use FNSAVE and FRSTOR. */
+static bool has_fxsr;
+static uint32_t cr4_bits;       /* CR4 bits to set on each CPU. */
+
+/* FPU state just after initialization, loaded by a thread's
+   first FPU instruction. */
+static uint8_t fpu_initial[FPU_AREA_SIZE] __attribute__ ((aligned (16)));
+
+static void *fpu_area (struct thread *);
+static void fpu_save (void *area);
+static void fpu_restore (void *area);
+static uint32_t read_cr0 (void);
+static void write_cr0 (uint32_t);
+
+/* Sets up the running CPU's FPU for lazy context switching.
+   Called on each CPU as it starts, with interrupts off. */
+void
+fpu_init (void) 
+{
+  bool bsp = cpu_current () == &cpus[0];
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (bsp) 
+    {
+      uint32_t eax = 1, ebx, ecx, edx;
+      asm ("cpuid" : "+a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx));
+      has_fxsr = (edx & CPUID_FXSR) != 0;
+      if (has_fxsr)
+        cr4_bits = CR4_OSFXSR | (edx & CPUID_SSE ? CR4_OSXMMEXCPT : 0);
+    }
+  if (cr4_bits != 0) 
+    {
+      uint32_t cr4;
+      asm volatile ("movl %%cr4, %0" : "=r" (cr4));
+      asm volatile ("movl %0, %%cr4" : : "r" (cr4 | cr4_bits));
+    }
+
+  /* loader.S set CR0.EM, which makes every FPU instruction trap,
+     even those that we use ourselves. */
+  write_cr0 ((read_cr0 () & ~(CR0_EM | CR0_TS)) | CR0_MP | CR0_NE);
+  asm volatile ("fninit");
+  if (bsp)
+    fpu_save (fpu_initial);
+  write_cr0 (read_cr0 () | CR0_TS);
+}
+
+/* Prepares the FPU for the running thread.  Called on every
+   context switch, by process_activate().  Only the running CPU's
+   FPU and fpu_owner are involved, so this turns off only its
+   interrupts, as schedule_tail() requires. */
+void
+fpu_activate (void) 
+{
+  struct thread *t = thread_current ();
+  enum intr_level old_level = intr_disable_local ();
+  struct cpu *c = cpu_current ();
+
+  if (c->fpu_owner == t)
+    asm volatile ("clts");
+  else 
+    {
+      if (cpu_cnt > 1 && c->fpu_owner != NULL) 
+        {
+          asm volatile ("clts");
+          fpu_save (fpu_area (c->fpu_owner));
+          c->fpu_owner = NULL;
+        }
+      write_cr0 (read_cr0 () | CR0_TS);
+    }
+
+  intr_set_level_local (old_level);
+}
+
+/* Handles a #NM exception raised by the running thread's use of
+   the FPU, by making it the running CPU's FPU owner.  Returns
+   true if successful, false if no memory was available for the
+   thread's save area.  Interrupts must be off. */
+bool
+fpu_load (void) 
+{
+  struct thread *t = thread_current ();
+  struct cpu *c;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t->fpu_area == NULL) 
+    {
+      void *area;
+
+      intr_enable ();
+      area = malloc (FPU_AREA_SIZE + FPU_AREA_ALIGN - 1);
+      intr_disable ();
+      if (area == NULL)
+        return false;
+      t->fpu_area = area;
+      memcpy (fpu_area (t), fpu_initial, FPU_AREA_SIZE);
+    }
+
+  /* We may have moved to another CPU while interrupts were on. */
+  c = cpu_current ();
+  asm volatile ("clts");
+  if (c->fpu_owner != t) 
+    {
+      if (c->fpu_owner != NULL)
+        fpu_save (fpu_area (c->fpu_owner));
+      fpu_restore (fpu_area (t));
+      c->fpu_owner = t;
+    }
+  return true;
+}
+
+/* Discards exiting thread T, the running thread's, FPU state and
+   frees its save area.  On a multiprocessor, fpu_activate()
+   clears the owner of a CPU that switches away from it, so only
+   the running CPU's FPU can hold T's state, and only its
+   interrupts need to be off. */
+void
+fpu_release (struct thread *t) 
+{
+  enum intr_level old_level = intr_disable_local ();
+  struct cpu *c = cpu_current ();
+
+  if (c->fpu_owner == t)
+    c->fpu_owner = NULL;
+  intr_set_level_local (old_level);
+
+  free (t->fpu_area);
+  t->fpu_area = NULL;
+}
+
+/* Returns T's save area, suitably aligned. */
+static void *
+fpu_area (struct thread *t) 
+{
+  ASSERT (t->fpu_area != NULL);
+  return (void *) ROUND_UP ((uintptr_t) t->fpu_area, FPU_AREA_ALIGN);
+}
+
+/* Saves the FPU state to AREA. */
+static void
+fpu_save (void *area) 
+{
+  if (has_fxsr)
+    asm volatile ("fxsave (%0)" : : "r" (area) : "memory");
+  else
+    asm volatile ("fnsave (%0); fwait" : : "r" (area) : "memory");
+}
+
+/* Loads the FPU state from AREA. */
+static void
+fpu_restore (void *area) 
+{
+  if (has_fxsr)
+    asm volatile ("fxrstor (%0)" : : "r" (area) : "memory");
+  else
+    asm volatile ("frstor (%0)" : : "r" (area) : "memory");
+}
+
+/* Returns the value of CR0. */
+static uint32_t
+read_cr0 (void) 
+{
+  uint32_t cr0;
+  asm volatile ("movl %%cr0, %0" : "=r" (cr0));
+  return cr0;
+}
+
+/* Sets CR0 to CR0. */
+static void
+write_cr0 (uint32_t cr0) 
+{
+  asm volatile ("movl %0, %%cr0" : : "r" (cr0));
+}
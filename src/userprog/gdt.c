@@ -2,6 +2,7 @@
 #include <debug.h>
 #include "userprog/tss.h"
 #include "threads/palloc.h"
+#include "threads/smp.h"
 #include "threads/vaddr.h"
 
 /* The Global Descriptor Table (GDT).
@@ -30,11 +31,15 @@ static uint64_t make_data_desc (int dpl);
 static uint64_t make_tss_desc (void *laddr);
 static uint64_t make_gdtr_operand (uint16_t limit, void *base);
 
-/* Sets up a proper GDT.  The bootstrap loader's GDT didn't
-   include user-mode selectors or a TSS, but we need both now. */
+/* Sets up a proper GDT and loads it on the running CPU.  The
+   bootstrap loader's GDT didn't include user-mode selectors or a
+   TSS, but we need both now.  All CPUs share the GDT, but each
+   has its own TSS and so its own TSS descriptor, which is filled
+   in when that CPU calls this function, after tss_init(). */
 void
 gdt_init (void)
 {
+  int cpu_id = cpu_current ()->id;
   uint64_t gdtr_operand;
 
   /* Initialize GDT. */
@@ -43,14 +48,14 @@ gdt_init (void)
   gdt[SEL_KDSEG / sizeof *gdt] = make_data_desc (0);
   gdt[SEL_UCSEG / sizeof *gdt] = make_code_desc (3);
   gdt[SEL_UDSEG / sizeof *gdt] = make_data_desc (3);
-  gdt[SEL_TSS / sizeof *gdt] = make_tss_desc (tss_get ());
+  gdt[SEL_TSS (cpu_id) / sizeof *gdt] = make_tss_desc (tss_get ());
 
   /* Load GDTR, TR.  See [IA32-v3a] 2.4.1 "Global Descriptor
      Table Register (GDTR)", 2.4.4 "Task Register (TR)", and
      6.2.4 "Task Register".  */
   gdtr_operand = make_gdtr_operand (sizeof gdt - 1, gdt);
   asm volatile ("lgdt %0" : : "m" (gdtr_operand));
-  asm volatile ("ltr %w0" : : "r" (SEL_TSS));
+  asm volatile ("ltr %w0" : : "r" (SEL_TSS (cpu_id)));
 }
 
 /* System segment or code/data segment? */
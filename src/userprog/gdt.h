@@ -2,13 +2,14 @@
 #define USERPROG_GDT_H
 
 #include "threads/loader.h"
+#include "threads/smp.h"
 
 /* Segment selectors.
    More selectors are defined by the loader in loader.h. */
 #define SEL_UCSEG       0x1B    /* User code selector. */
 #define SEL_UDSEG       0x23    /* User data selector. */
-#define SEL_TSS         0x28    /* Task-state segment. */
-#define SEL_CNT         6       /* Number of segments. */
+#define SEL_TSS(CPU)    (0x28 + 8 * (CPU)) /* Task-state segment of CPU. */
+#define SEL_CNT         (5 + CPU_MAX)      /* Number of segments. */
 
 void gdt_init (void);
 
@@ -12,7 +12,11 @@ static void invalidate_pagedir (uint32_t *);
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
    Returns the new page directory, or a null pointer if memory
-   allocation fails. */
+   allocation fails.
+
+   The kernel mappings are the PDEs of base_page_dir, copied as
+   is.  Those that map 4 MB pages thus map the same pages here,
+   and the others share base_page_dir's page tables. */
 uint32_t *
 pagedir_create (void) 
 {
@@ -158,6 +162,16 @@ pagedir_clear_page (uint32_t *pd, void *upage)
     }
 }
 
+/* Returns true if virtual page VPAGE in PD is mapped, accessible
+   to user code, and writable, false otherwise. */
+bool
+pagedir_is_writable (uint32_t *pd, const void *vpage) 
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  uint32_t flags = PTE_P | PTE_U | PTE_W;
+  return pte != NULL && (*pte & flags) == flags;
+}
+
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
    that is, if the page has been modified since the PTE was
    installed.
@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "userprog/fpu.h"
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
 #include "userprog/tss.h"
@@ -116,6 +117,8 @@ process_exit (void)
       pagedir_activate (NULL);
       pagedir_destroy (pd);
     }
+
+  fpu_release (curr);
 }
 
 /* Sets up the CPU for running user code in the current
@@ -132,6 +135,10 @@ process_activate (void)
   /* Set thread's kernel stack for use in processing
      interrupts. */
   tss_update ();
+
+  /* Make the thread's first FPU instruction trap, unless the FPU
+     already holds its state. */
+  fpu_activate ();
 }
 
 /* We load ELF binaries.  The following definitions are taken
@@ -1,10 +1,16 @@
 #include "userprog/syscall.h"
+#include <cpu-usage.h>
 #include <stdio.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
 
 static void syscall_handler (struct intr_frame *);
+static bool copy_in (void *dst, const void *usrc, size_t size);
+static bool copy_out (void *udst, const void *src, size_t size);
+static int sys_cpu_usage (const uint32_t *args);
 
 void
 syscall_init (void) 
@@ -13,8 +19,94 @@ syscall_init (void)
 }
 
 static void
-syscall_handler (struct intr_frame *f UNUSED) 
+syscall_handler (struct intr_frame *f) 
 {
-  printf ("system call!\n");
-  thread_exit ();
+  uint32_t args[3];
+
+  /* The system call number is at the top of the user stack,
+     followed by up to three arguments. */
+  if (!copy_in (args, f->esp, sizeof *args))
+    thread_exit ();
+
+  switch (args[0])
+    {
+    case SYS_CPU_USAGE:
+      if (!copy_in (args, (uint32_t *) f->esp + 1, 2 * sizeof *args))
+        thread_exit ();
+      f->eax = sys_cpu_usage (args);
+      break;
+
+    default:
+      printf ("system call!\n");
+      thread_exit ();
+    }
+}
+
+/* cpu_usage (PID, USAGE): Copies the CPU usage of process PID, or
+   of the calling process if PID is 0, to USAGE in user memory.
+   PID may have exited already, for example a child process that
+   has been waited for, as long as it was recent enough (see
+   thread_get_usage()).  Returns true if successful, false if
+   there is no such process.  Kills the caller if USAGE is a bad
+   pointer. */
+static int
+sys_cpu_usage (const uint32_t *args)
+{
+  tid_t tid = args[0] != 0 ? (tid_t) args[0] : thread_tid ();
+  struct cpu_usage usage;
+
+  if (!thread_get_usage (tid, &usage))
+    return false;
+  if (!copy_out ((void *) args[1], &usage, sizeof usage))
+    thread_exit ();
+  return true;
+}
+
+/* Copies SIZE bytes from user address USRC to kernel address
+   DST.  Returns true if successful, false if any of the source
+   bytes is not mapped in the running process's user address
+   space. */
+static bool
+copy_in (void *dst_, const void *usrc_, size_t size)
+{
+  uint8_t *dst = dst_;
+  const uint8_t *usrc = usrc_;
+
+  for (; size > 0; size--, dst++, usrc++)
+    {
+      const uint8_t *src;
+
+      if (!is_user_vaddr (usrc))
+        return false;
+      src = pagedir_get_page (thread_current ()->pagedir, usrc);
+      if (src == NULL)
+        return false;
+      *dst = *src;
+    }
+  return true;
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+   UDST.  Returns true if successful, false if any of the
+   destination bytes is not mapped writable in the running
+   process's user address space. */
+static bool
+copy_out (void *udst_, const void *src_, size_t size)
+{
+  uint8_t *udst = udst_;
+  const uint8_t *src = src_;
+
+  for (; size > 0; size--, udst++, src++)
+    {
+      uint8_t *dst;
+
+      if (!is_user_vaddr (udst)
+          || !pagedir_is_writable (thread_current ()->pagedir, udst))
+        return false;
+      dst = pagedir_get_page (thread_current ()->pagedir, udst);
+      if (dst == NULL)
+        return false;
+      *dst = *src;
+    }
+  return true;
 }